@@ -0,0 +1,58 @@
+// Push, iteration and random access over Deque<int> for a range of block sizes. 16 is the
+// block size every Deque had before it became a template parameter, 128 the new default
+// for int (512 bytes).
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "../deque.h"
+
+constexpr size_t elements = 1 << 22;
+
+template <size_t BlockSize>
+void run() {
+    using D = Deque<int, std::allocator<int>, BlockSize>;
+    double push = bench_ms([] {
+        D d;
+        for (size_t i = 0; i < elements; ++i) {
+            d.push_back(static_cast<int>(i));
+        }
+        bench_sink = bench_sink + d.size();
+    });
+
+    D d;
+    for (size_t i = 0; i < elements; ++i) {
+        d.push_back(static_cast<int>(i));
+    }
+    double iterate = bench_ms([&d] {
+        size_t sum = 0;
+        for (int x : d) {
+            sum += x;
+        }
+        bench_sink = bench_sink + sum;
+    });
+
+    std::vector<size_t> indices(elements);
+    std::mt19937_64 rng(1);
+    for (size_t& i : indices) {
+        i = rng() % elements;
+    }
+    double random = bench_ms([&d, &indices] {
+        size_t sum = 0;
+        for (size_t i : indices) {
+            sum += d[i];
+        }
+        bench_sink = bench_sink + sum;
+    });
+    std::printf("%6zu %12.2f %12.2f %12.2f\n", BlockSize, push, iterate, random);
+}
+
+int main() {
+    std::printf("%zu ints, best of 5, ms\n", elements);
+    std::printf("%6s %12s %12s %12s\n", "block", "push_back", "iterate", "random []");
+    run<4>();
+    run<16>();
+    run<64>();
+    run<128>();
+    run<512>();
+    run<4096>();
+}
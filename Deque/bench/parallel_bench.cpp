@@ -0,0 +1,46 @@
+// Scaling of the parallel Deque algorithms from 1 thread up to the number of hardware
+// threads, on a Deque of 8M doubles.
+#include <cmath>
+#include <random>
+#include <thread>
+#include "bench.h"
+#include "../parallel.h"
+
+constexpr size_t elements = 1 << 23;
+
+int main() {
+    size_t cores = std::thread::hardware_concurrency();
+    if (cores == 0) {
+        cores = 1;
+    }
+    Deque<double> in;
+    std::mt19937_64 rng(1);
+    std::uniform_real_distribution<double> dist(0.0, 1.0);
+    for (size_t i = 0; i < elements; ++i) {
+        in.push_back(dist(rng));
+    }
+    Deque<double> out(elements);
+
+    std::printf("%zu doubles, best of 3, ms\n", elements);
+    std::printf("%8s %12s %12s %12s %12s\n", "threads", "for_each", "transform", "reduce", "sort");
+    for (size_t threads = 1; threads <= cores; ++threads) {
+        double for_each = bench_ms([&out, threads] {
+            parallel_for_each(out, [](double& x) {
+                x = std::sqrt(x + 1.0);
+            }, threads);
+        }, 3);
+        double transform = bench_ms([&in, &out, threads] {
+            parallel_transform(in, out, [](double x) {
+                return std::sin(x) * std::cos(x);
+            }, threads);
+        }, 3);
+        double reduce = bench_ms([&in, threads] {
+            bench_sink = bench_sink + static_cast<size_t>(parallel_reduce(in, 0.0, std::plus<>(), threads));
+        }, 3);
+        double sort = bench_ms([&in, &out, threads] {
+            out = in;
+            parallel_sort(out, std::less<>(), threads);
+        }, 3);
+        std::printf("%8zu %12.2f %12.2f %12.2f %12.2f\n", threads, for_each, transform, reduce, sort);
+    }
+}
@@ -0,0 +1,48 @@
+// Random access through iterators: std::sort and binary search over Deque<int>, compared
+// with std::deque<int> and std::vector<int>.
+#include <algorithm>
+#include <deque>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "../deque.h"
+
+constexpr size_t elements = 1 << 21;
+constexpr size_t lookups = 1 << 20;
+
+template <typename C>
+void run(const char* name) {
+    std::mt19937 rng(1);
+    std::vector<int> values(elements);
+    for (int& v : values) {
+        v = static_cast<int>(rng());
+    }
+    C c;
+    double sort = bench_ms([&c, &values] {
+        c = C();
+        for (int v : values) {
+            c.push_back(v);
+        }
+        std::sort(c.begin(), c.end());
+    }, 3);
+    std::vector<int> keys(lookups);
+    for (int& k : keys) {
+        k = static_cast<int>(rng());
+    }
+    double search = bench_ms([&c, &keys] {
+        size_t found = 0;
+        for (int k : keys) {
+            found += std::binary_search(c.begin(), c.end(), k);
+        }
+        bench_sink = bench_sink + found;
+    }, 3);
+    std::printf("%-16s %14.2f %14.2f\n", name, sort, search);
+}
+
+int main() {
+    std::printf("%zu ints, %zu lookups, best of 3, ms\n", elements, lookups);
+    std::printf("%-16s %14s %14s\n", "", "fill + sort", "binary_search");
+    run<Deque<int>>("Deque");
+    run<std::deque<int>>("std::deque");
+    run<std::vector<int>>("std::vector");
+}
@@ -0,0 +1,90 @@
+// Hand-off throughput between a producer and a consumer thread: SpscDeque with single
+// and bulk operations against a Deque guarded by a std::mutex.
+#include <mutex>
+#include <thread>
+#include "bench.h"
+#include "../spsc_deque.h"
+
+constexpr size_t items = 1 << 22;
+constexpr size_t batch = 64;
+
+double spsc_single() {
+    return bench_ms([] {
+        SpscDeque<size_t> q;
+        std::thread producer([&q] {
+            for (size_t i = 0; i < items; ++i) {
+                q.push_back(i);
+            }
+        });
+        size_t sum = 0;
+        size_t x;
+        for (size_t got = 0; got < items;) {
+            if (q.pop_front(x)) {
+                sum += x;
+                ++got;
+            }
+        }
+        producer.join();
+        bench_sink = bench_sink + sum;
+    }, 3);
+}
+
+double spsc_bulk() {
+    return bench_ms([] {
+        SpscDeque<size_t> q;
+        std::thread producer([&q] {
+            size_t buf[batch];
+            for (size_t i = 0; i < items; i += batch) {
+                for (size_t k = 0; k < batch; ++k) {
+                    buf[k] = i + k;
+                }
+                q.push_bulk(buf, batch);
+            }
+        });
+        size_t sum = 0;
+        size_t buf[batch];
+        for (size_t got = 0; got < items;) {
+            size_t n = q.pop_bulk(buf, batch);
+            for (size_t k = 0; k < n; ++k) {
+                sum += buf[k];
+            }
+            got += n;
+        }
+        producer.join();
+        bench_sink = bench_sink + sum;
+    }, 3);
+}
+
+double mutex_deque() {
+    return bench_ms([] {
+        Deque<size_t> q;
+        std::mutex m;
+        std::thread producer([&q, &m] {
+            for (size_t i = 0; i < items; ++i) {
+                std::lock_guard<std::mutex> lock(m);
+                q.push_back(i);
+            }
+        });
+        size_t sum = 0;
+        for (size_t got = 0; got < items;) {
+            std::lock_guard<std::mutex> lock(m);
+            if (q.size() > 0) {
+                sum += q[0];
+                q.pop_front();
+                ++got;
+            }
+        }
+        producer.join();
+        bench_sink = bench_sink + sum;
+    }, 3);
+}
+
+int main() {
+    std::printf("%zu items, best of 3, ms (Mitems/s)\n", items);
+    double t = mutex_deque();
+    std::printf("%-22s %10.2f (%.1f)\n", "mutex + Deque", t, items / t / 1e3);
+    t = spsc_single();
+    std::printf("%-22s %10.2f (%.1f)\n", "SpscDeque single", t, items / t / 1e3);
+    t = spsc_bulk();
+    std::printf("%-22s %10.2f (%.1f)\n", "SpscDeque bulk 64", t, items / t / 1e3);
+}
@@ -0,0 +1,83 @@
+// Fork-join scaling of WorkStealingDeque: a sum over a large range is split recursively,
+// every worker owns a deque, pushes the halves it splits off and steals from the others
+// when its own deque runs dry. Reported for 1 up to the number of hardware threads.
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "../work_stealing_deque.h"
+
+constexpr uint64_t range = uint64_t(1) << 30;
+constexpr uint64_t grain = 1 << 14;
+
+// A range [lo, lo + len) packed into one word, so that the deque slots are lock-free atomics.
+using Task = uint64_t;
+
+Task make_task(uint64_t lo, uint64_t len) {
+    return lo << 32 | len;
+}
+
+uint64_t leaf(uint64_t lo, uint64_t hi) {
+    uint64_t sum = 0;
+    for (uint64_t i = lo; i < hi; ++i) {
+        sum += i * i % 7;
+    }
+    return sum;
+}
+
+double run(size_t threads) {
+    return bench_ms([threads] {
+        std::vector<WorkStealingDeque<Task>> deques(threads);
+        std::atomic<uint64_t> done{0};
+        std::atomic<uint64_t> total{0};
+        auto worker = [&](size_t me) {
+            uint64_t sum = 0;
+            size_t victim = me;
+            while (done.load(std::memory_order_acquire) < range) {
+                std::optional<Task> task = deques[me].pop_back();
+                if (!task) {
+                    victim = (victim + 1) % threads;
+                    if (victim == me) continue;
+                    task = deques[victim].pop_front();
+                    if (!task) continue;
+                }
+                uint64_t lo = *task >> 32;
+                uint64_t len = *task & 0xffffffff;
+                while (len > grain) {
+                    len /= 2;
+                    deques[me].push_back(make_task(lo + len, len));
+                }
+                sum += leaf(lo, lo + len);
+                done.fetch_add(len, std::memory_order_release);
+            }
+            total.fetch_add(sum);
+        };
+        deques[0].push_back(make_task(0, range));
+        std::vector<std::thread> pool;
+        for (size_t k = 1; k < threads; ++k) {
+            pool.emplace_back(worker, k);
+        }
+        worker(0);
+        for (std::thread& t : pool) {
+            t.join();
+        }
+        bench_sink = bench_sink + total.load();
+    }, 3);
+}
+
+int main() {
+    size_t cores = std::thread::hardware_concurrency();
+    if (cores == 0) {
+        cores = 1;
+    }
+    std::printf("sum over 2^30 elements, leaves of %llu, best of 3\n", static_cast<unsigned long long>(grain));
+    std::printf("%8s %10s %8s\n", "threads", "ms", "speedup");
+    double base = 0;
+    for (size_t threads = 1; threads <= cores; ++threads) {
+        double t = run(threads);
+        if (threads == 1) {
+            base = t;
+        }
+        std::printf("%8zu %10.2f %8.2f\n", threads, t, base / t);
+    }
+}
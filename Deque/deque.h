@@ -1,120 +1,143 @@
+#pragma once
 #include <iostream>
 #include <vector>
 #include <stdexcept>
 #include <algorithm>
 #include <type_traits>
+#include <memory>
+#include <new>
+#include <cstring>
+#include <numeric>
+#include <span>
+#include <bit>
+
+// Default block size: as many elements as fit into 512 bytes, rounded down to a power
+// of two, but never fewer than 4, so that small types get reasonably large blocks and
+// large types don't get huge ones.
+constexpr size_t deque_block_bytes = 512;
+constexpr size_t deque_cache_line = 64;
+// How many emptied blocks a Deque keeps for reuse before giving them back to the allocator.
+constexpr size_t deque_spare_blocks = 4;
 
 template <typename T>
+constexpr size_t deque_block_size() {
+    return sizeof(T) * 4 < deque_block_bytes ? std::bit_floor(deque_block_bytes / sizeof(T)) : 4;
+}
+
+template <typename T, typename Allocator = std::allocator<T>, size_t BlockSize = deque_block_size<T>()>
 class Deque {
+    static_assert(std::has_single_bit(BlockSize), "Deque block size must be a power of two");
 private:
-    T** dq;
-    size_t dq_size;
-    size_t cap;
-    const static size_t minicap = 16;
+    // Positions inside the deque are split into block and slot with a shift and a mask.
+    constexpr static size_t minicap = BlockSize;
+    constexpr static size_t minishift = std::countr_zero(BlockSize);
+    constexpr static size_t minimask = BlockSize - 1;
+    // Blocks start on a cache line boundary (or stricter, for over-aligned T).
+    constexpr static size_t block_align = alignof(T) > deque_cache_line ? alignof(T) : deque_cache_line;
+    struct alignas(block_align) Block {
+        uint8_t bytes[minicap * sizeof(T)];
+    };
+
+public:
+    using AllocTraits = std::allocator_traits<Allocator>;
+    using BlockAlloc = typename AllocTraits::template rebind_alloc<Block>;
+    using BlockTraits = std::allocator_traits<BlockAlloc>;
+    using MapAlloc = typename AllocTraits::template rebind_alloc<T*>;
+    using MapTraits = std::allocator_traits<MapAlloc>;
+
+private:
+    T** dq = nullptr;
+    size_t dq_size = 0;
+    size_t cap = 0;
     struct miniArray;
     miniArray top;
     miniArray bottom;
-    void reserve(size_t up_cap, size_t down_cap);
+    // Emptied blocks are kept in an intrusive singly linked list: the first bytes of
+    // a spare block hold the pointer to the next one.
+    T* spare = nullptr;
+    size_t spare_count = 0;
+    double growth = 2.0;
+    Allocator alloc;
+
+    void grow_map(bool at_front);
+    void reallocate_map(size_t new_cap, bool at_front);
+    void init_map();
     size_t get_apos(size_t index) const;
     size_t get_minipos(size_t index) const;
+    T* allocate_block();
+    void deallocate_block(T* block);
+    T* acquire_block();
+    void release_block(T* block);
+    void release_spare();
+    T** allocate_map(size_t n);
+    void deallocate_map(T** map, size_t n);
+    void destroy_elements();
+    void free_storage();
+    // Exchanges everything but the allocators, which the callers handle.
+    void swap_storage(Deque& other);
+    void move_elements(size_t from, size_t count, size_t to);
+    template <typename... Args>
+    void fill(size_t n, const Args&... args);
+    void copy_blocks(const Deque& copy);
 
 public:
-    Deque(): top(0, minicap - 1), bottom(0, minicap - 1) {
-        dq_size = 0;
-        cap = 4;
-        dq = new T*[4];
-        size_t exit = 0;
-        try {
-            for (size_t i = 0; i < 4; ++i) {
-                dq[i] = reinterpret_cast<T*>(new uint8_t[minicap * sizeof(T)]);
-                ++exit;
-            }
-        } catch (...) {
-            for (size_t i = 0; i < exit; ++i) {
-                delete[] reinterpret_cast<uint8_t*>(dq[i]);
-            }
-            delete[] dq;
-            throw;
+    Deque(): Deque(Allocator()) {}
+
+    // An empty deque owns no memory: the map and the first block are allocated by the first push.
+    explicit Deque(const Allocator& al): top(0, 0), bottom(0, 0), alloc(al) {}
+
+    Deque(const Deque& copy): Deque(copy, AllocTraits::select_on_container_copy_construction(copy.alloc)) {}
+
+    Deque(const Deque& copy, const Allocator& al): top(0, 0), bottom(0, 0), growth(copy.growth), alloc(al) {
+        if constexpr (std::is_trivially_copyable_v<T>) {
+            copy_blocks(copy);
+        } else {
+            fill(copy.dq_size, copy);
         }
     }
 
-    Deque(const Deque& copy): dq_size(copy.dq_size), cap(copy.cap), top(copy.top), bottom(copy.bottom) {
-        dq = new T*[cap];
-        size_t exit = 0, exi = 0, exj = 0;
-        try {
-            for (size_t i = 0; i < cap; ++i) {
-                dq[i] = reinterpret_cast<T*>(new uint8_t[minicap * sizeof(T)]);
-                ++exit;
-            }
-            for (size_t j = top.edge; j < minicap; ++j) {
-                new(dq[top.apos] + j) T(copy.dq[top.apos][j]);
-                exj = j + 1;
-            }
-            for (size_t i = top.apos + 1; i < bottom.apos; ++i) {
-                for (size_t j = 0; j < minicap; ++j) {
-                    new(dq[i] + j) T(copy.dq[i][j]);
-                    exj = j + 1;
-                }
-                exi = i + 1;
-            }
-            if (bottom.apos != top.apos) {
-                for (size_t j = 0; j <= bottom.edge; ++j) {
-                    new(dq[bottom.apos] + j) T(copy.dq[bottom.apos][j]);
-                    exj = j + 1;
-                }
-            }
-        } catch (...) {
-            for (size_t j = top.edge; j < (exi == top.apos ? exj : minicap); ++j) {
-                (dq[top.apos] + j)->~T();
-            }
-            for (size_t i = top.apos + 1; i < exi; ++i) {
-                for (size_t j = 0; j < minicap; ++j) {
-                    (dq[i] + j)->~T();
-                }
-            }
-            if (exi != top.apos) {
-                for (size_t j = 0; j < exj; ++j) {
-                    (dq[exi] + j)->~T();
-                }
-            }
-            for (size_t i = 0; i < exit; ++i) {
-                delete[] reinterpret_cast<uint8_t*>(dq[i]);
-            }
-            delete[] dq;
-            throw;
-        }
+    Deque(Deque&& other) noexcept: top(0, 0), bottom(0, 0), growth(other.growth), alloc(other.alloc) {
+        swap_storage(other);
     }
 
     ~Deque() {
-        for (size_t j = top.edge; j < minicap; ++j) {
-            (dq[top.apos] + j)->~T();
+        free_storage();
+    }
+
+    explicit Deque(size_t n, const T& val = T(), const Allocator& al = Allocator());
+
+    Deque& operator=(const Deque& c) {
+        if (this == &c) return *this;
+        Deque copy(c, AllocTraits::propagate_on_container_copy_assignment::value ? c.alloc : alloc);
+        swap_storage(copy);
+        if constexpr (AllocTraits::propagate_on_container_copy_assignment::value) {
+            std::swap(alloc, copy.alloc);
         }
-        for (size_t i = top.apos + 1; i < bottom.apos; ++i) {
-            for (size_t j = 0; j < minicap; ++j) {
-                (dq[i] + j)->~T();
+        return *this;
+    }
+
+    Deque& operator=(Deque&& other) noexcept(AllocTraits::propagate_on_container_move_assignment::value
+                                             || AllocTraits::is_always_equal::value) {
+        if (this == &other) return *this;
+        if (AllocTraits::propagate_on_container_move_assignment::value || alloc == other.alloc) {
+            Deque tmp(std::move(other));
+            swap_storage(tmp);
+            if constexpr (AllocTraits::propagate_on_container_move_assignment::value) {
+                std::swap(alloc, tmp.alloc);
             }
-        }
-        if (bottom.apos != top.apos) {
-            for (size_t j = 0; j <= bottom.edge; ++j) {
-                (dq[bottom.apos] + j)->~T();
+        } else {
+            // Storage can't change hands between unequal allocators, so the elements move one by one.
+            Deque tmp(alloc);
+            for (size_t i = 0; i < other.dq_size; ++i) {
+                tmp.push_back(std::move(other[i]));
             }
+            swap_storage(tmp);
         }
-        for (size_t i = 0; i < cap; ++i) {
-            delete[] reinterpret_cast<uint8_t*>(dq[i]);
-        }
-        delete[] dq;
+        return *this;
     }
 
-    explicit Deque(int n, const T& val = T());
-
-    Deque& operator=(const Deque& c) {
-        Deque<T> copy = c;
-        miniArray::swap(top, copy.top);
-        miniArray::swap(bottom, copy.bottom);
-        std::swap(dq_size, copy.dq_size);
-        std::swap(cap, copy.cap);
-        std::swap(*dq, *copy.dq);
-        return *this;
+    Allocator get_allocator() const {
+        return alloc;
     }
 
     T& operator[](size_t index);
@@ -125,11 +148,57 @@ public:
         return dq_size;
     }
 
-    void push_back(T val);
-    void push_front(T val);
+    template <typename... Args>
+    T& emplace_back(Args&&... args);
+    template <typename... Args>
+    T& emplace_front(Args&&... args);
+
+    void push_back(const T& val) {
+        emplace_back(val);
+    }
+    void push_back(T&& val) {
+        emplace_back(std::move(val));
+    }
+    void push_front(const T& val) {
+        emplace_front(val);
+    }
+    void push_front(T&& val) {
+        emplace_front(std::move(val));
+    }
     void pop_back();
     void pop_front();
 
+    // How much the map grows when it runs out of slots at one end and can't just be
+    // recentred. A setting of this deque only; copies and moves take it along.
+    double growth_factor() const {
+        return growth;
+    }
+    void set_growth_factor(double factor) {
+        if (!(factor > 1.0)) {
+            throw std::invalid_argument("Deque growth factor must be greater than 1");
+        }
+        growth = factor;
+    }
+
+    // Makes the map big enough that the deque can hold n elements without reallocating it.
+    // Blocks are still allocated only when they are first used.
+    void reserve(size_t n);
+    // Gives the cached spare blocks back to the allocator and trims the map
+    // (an empty deque releases everything).
+    void shrink_to_fit();
+
+    struct MemoryUsage {
+        size_t map_bytes = 0;
+        size_t live_blocks = 0;     // blocks referenced from the map
+        size_t spare_blocks = 0;    // emptied blocks cached for reuse
+        size_t block_bytes = 0;     // bytes taken by live and spare blocks
+        size_t wasted_slots = 0;    // element slots in live blocks that hold no element
+        size_t total_bytes() const {
+            return map_bytes + block_bytes;
+        }
+    };
+    MemoryUsage memory_usage() const;
+
     template<bool is_const>
     class Iter;
 
@@ -138,34 +207,49 @@ public:
     using const_reverse_iterator = std::reverse_iterator<Iter<true>>;
     using reverse_iterator = std::reverse_iterator<Iter<false>>;
 
+    // The elements as a sequence of contiguous spans, one per block.
+    template<bool is_const>
+    class SegmentRange;
+
+    SegmentRange<false> segments() {
+        return SegmentRange<false>(this);
+    }
+    SegmentRange<true> segments() const {
+        return SegmentRange<true>(this);
+    }
+
+    template <typename F>
+    void for_each_segment(F f) {
+        for (std::span<T> seg : segments()) {
+            f(seg);
+        }
+    }
+    template <typename F>
+    void for_each_segment(F f) const {
+        for (std::span<const T> seg : segments()) {
+            f(seg);
+        }
+    }
+
     iterator begin() {
         return iterator(dq + top.apos, top.edge);
     }
     iterator end() {
-        if (bottom.edge == minicap - 1) {
-            return iterator(dq + bottom.apos + 1, 0);
-        }
-        return iterator(dq + bottom.apos, bottom.edge + 1);
+        return iterator(dq + get_apos(dq_size), get_minipos(dq_size));
     }
 
     const_iterator begin() const {
         return const_iterator(dq + top.apos, top.edge);
     }
     const_iterator end() const {
-        if (bottom.edge == minicap - 1) {
-            return const_iterator(dq + bottom.apos + 1, 0);
-        }
-        return const_iterator(dq + bottom.apos, bottom.edge + 1);
+        return const_iterator(dq + get_apos(dq_size), get_minipos(dq_size));
     }
 
     const_iterator cbegin() const {
         return const_iterator(dq + top.apos, top.edge);
     }
     const_iterator cend() const {
-        if (bottom.edge == minicap - 1) {
-            return const_iterator(dq + bottom.apos + 1, 0);
-        }
-        return const_iterator(dq + bottom.apos, bottom.edge + 1);
+        return const_iterator(dq + get_apos(dq_size), get_minipos(dq_size));
     }
 
     reverse_iterator rbegin() {
@@ -188,34 +272,103 @@ public:
         return std::reverse_iterator(cbegin());
     };
 
-    void insert(Deque::iterator it, const T& val) {
-        push_front(val);
-        for (iterator i = begin(); i < it - 1; ++i) {
-            T t = *i;
-            *i = *(i + 1);
-            *(i + 1) = t;
+    // Insertion and erasure shift whichever side of the position is shorter.
+    iterator insert(iterator it, const T& val) {
+        T tmp(val);
+        return insert(it, std::make_move_iterator(&tmp), std::make_move_iterator(&tmp + 1));
+    }
+    iterator insert(iterator it, T&& val) {
+        return insert(it, std::make_move_iterator(&val), std::make_move_iterator(&val + 1));
+    }
+    template <typename ForwardIt>
+    iterator insert(iterator it, ForwardIt first, ForwardIt last);
+
+    iterator erase(iterator it) {
+        return erase(it, it + 1);
+    }
+    iterator erase(iterator first, iterator last);
+
+    // Algorithm overloads for a whole Deque. They run the standard algorithm on each
+    // contiguous segment, so the inner loops work on plain pointers and vectorize.
+    // They are hidden friends, found only by argument-dependent lookup on a Deque.
+    template <typename F>
+    friend F for_each(Deque& d, F f) {
+        for (std::span<T> seg : d.segments()) {
+            for (T* p = seg.data(); p != seg.data() + seg.size(); ++p) {
+                f(*p);
+            }
         }
+        return f;
+    }
+    template <typename F>
+    friend F for_each(const Deque& d, F f) {
+        for (std::span<const T> seg : d.segments()) {
+            for (const T* p = seg.data(); p != seg.data() + seg.size(); ++p) {
+                f(*p);
+            }
+        }
+        return f;
+    }
+
+    template <typename OutputIt>
+    friend OutputIt copy(const Deque& d, OutputIt out) {
+        for (std::span<const T> seg : d.segments()) {
+            out = std::copy(seg.data(), seg.data() + seg.size(), out);
+        }
+        return out;
     }
 
-    void erase(Deque::iterator it) {
-        for (iterator i = it; i > begin(); --i) {
-            T t = *i;
-            *i = *(i - 1);
-            *(i - 1) = t;
+    friend void fill(Deque& d, const T& val) {
+        for (std::span<T> seg : d.segments()) {
+            std::fill(seg.data(), seg.data() + seg.size(), val);
         }
-        pop_front();
+    }
+
+    template <typename U>
+    friend U accumulate(const Deque& d, U init) {
+        for (std::span<const T> seg : d.segments()) {
+            init = std::accumulate(seg.data(), seg.data() + seg.size(), std::move(init));
+        }
+        return init;
+    }
+
+    friend iterator find(Deque& d, const T& val) {
+        std::ptrdiff_t offset = 0;
+        for (std::span<T> seg : d.segments()) {
+            T* p = std::find(seg.data(), seg.data() + seg.size(), val);
+            if (p != seg.data() + seg.size()) {
+                return d.begin() + (offset + (p - seg.data()));
+            }
+            offset += static_cast<std::ptrdiff_t>(seg.size());
+        }
+        return d.end();
+    }
+    friend const_iterator find(const Deque& d, const T& val) {
+        std::ptrdiff_t offset = 0;
+        for (std::span<const T> seg : d.segments()) {
+            const T* p = std::find(seg.data(), seg.data() + seg.size(), val);
+            if (p != seg.data() + seg.size()) {
+                return d.begin() + (offset + (p - seg.data()));
+            }
+            offset += static_cast<std::ptrdiff_t>(seg.size());
+        }
+        return d.end();
     }
 };
 
-template <typename T>
+template <typename T, typename Allocator, size_t BlockSize>
 template <bool is_const>
-class Deque<T>::Iter {
+class Deque<T, Allocator, BlockSize>::Iter {
 private:
-    T** apoint;
-    size_t pos;
+    T** apoint = nullptr;
+    size_t pos = 0;
 public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+    using iterator_category = std::random_access_iterator_tag;
     using reference = std::conditional_t<is_const, const T&, T&>;
     using pointer = std::conditional_t<is_const, const T*, T*>;
+    Iter() = default;
     Iter(T** apoint, size_t pos): apoint(apoint), pos(pos) {};
     Iter& operator++() {
         if (pos < minicap - 1) {
@@ -245,21 +398,31 @@ public:
         --(*this);
         return it;
     }
-    Iter<is_const> operator+(const int& n) const {
-        auto p = static_cast<int>(pos);
-        if(p + n >= 0) {
-            return Iter<is_const>(apoint + (p + n) / minicap, (p + n) % minicap);
-        } else {
-            return Iter<is_const>(apoint - 1 - (-n - p - 1) / minicap,
-                                  (minicap - (-n - p) % minicap) % minicap);
-        }
+    // The arithmetic shift rounds towards minus infinity, so negative offsets
+    // need no separate path.
+    Iter<is_const> operator+(difference_type n) const {
+        difference_type p = static_cast<difference_type>(pos) + n;
+        return Iter<is_const>(apoint + (p >> minishift), static_cast<size_t>(p) & minimask);
     }
-    Iter<is_const> operator-(const int& n) const {
+    Iter<is_const> operator-(difference_type n) const {
         return *this + (-n);
     }
+    Iter& operator+=(difference_type n) {
+        return *this = *this + n;
+    }
+    Iter& operator-=(difference_type n) {
+        return *this = *this + (-n);
+    }
+    friend Iter<is_const> operator+(difference_type n, const Iter<is_const>& it) {
+        return it + n;
+    }
+    reference operator[](difference_type n) const {
+        return *(*this + n);
+    }
 
-    int operator-(const Iter<is_const>& it) const {
-        return (apoint - it.apoint) * minicap + pos - it.pos;
+    difference_type operator-(const Iter<is_const>& it) const {
+        return ((apoint - it.apoint) << minishift) + static_cast<difference_type>(pos)
+               - static_cast<difference_type>(it.pos);
     }
 
     bool operator==(const Iter<is_const>& it) const {
@@ -288,8 +451,60 @@ public:
     }
 };
 
-template<typename T>
-struct Deque<T>::miniArray {
+template <typename T, typename Allocator, size_t BlockSize>
+template <bool is_const>
+class Deque<T, Allocator, BlockSize>::SegmentRange {
+private:
+    using deque_pointer = std::conditional_t<is_const, const Deque*, Deque*>;
+    using span_type = std::span<std::conditional_t<is_const, const T, T>>;
+    deque_pointer d;
+
+public:
+    class iterator {
+    private:
+        deque_pointer d = nullptr;
+        size_t apos = 0;
+    public:
+        using difference_type = std::ptrdiff_t;
+        using value_type = span_type;
+        using iterator_category = std::forward_iterator_tag;
+        using reference = span_type;
+        using pointer = void;
+        iterator() = default;
+        iterator(deque_pointer d, size_t apos): d(d), apos(apos) {}
+        span_type operator*() const {
+            size_t first = apos == d->top.apos ? d->top.edge : 0;
+            size_t last = apos == d->bottom.apos ? d->bottom.edge + 1 : minicap;
+            return span_type(d->dq[apos] + first, last - first);
+        }
+        iterator& operator++() {
+            ++apos;
+            return *this;
+        }
+        iterator operator++(int) {
+            iterator it = *this;
+            ++apos;
+            return it;
+        }
+        bool operator==(const iterator& it) const {
+            return apos == it.apos;
+        }
+        bool operator!=(const iterator& it) const {
+            return apos != it.apos;
+        }
+    };
+
+    explicit SegmentRange(deque_pointer d): d(d) {}
+    iterator begin() const {
+        return iterator(d, d->top.apos);
+    }
+    iterator end() const {
+        return iterator(d, d->dq_size == 0 ? d->top.apos : d->bottom.apos + 1);
+    }
+};
+
+template<typename T, typename Allocator, size_t BlockSize>
+struct Deque<T, Allocator, BlockSize>::miniArray {
     size_t apos = 0;
     size_t edge = 0;
     miniArray(size_t apos, size_t edge): apos(apos), edge(edge) {};
@@ -299,200 +514,476 @@ struct Deque<T>::miniArray {
     }
 };
 
-template<typename T>
-size_t Deque<T>::get_apos(size_t index) const {
-    return top.apos + (top.edge + index) / minicap;
+template<typename T, typename Allocator, size_t BlockSize>
+size_t Deque<T, Allocator, BlockSize>::get_apos(size_t index) const {
+    return top.apos + ((top.edge + index) >> minishift);
 }
-template<typename T>
-size_t Deque<T>::get_minipos(size_t index) const {
-    return (top.edge + index) % minicap;
+template<typename T, typename Allocator, size_t BlockSize>
+size_t Deque<T, Allocator, BlockSize>::get_minipos(size_t index) const {
+    return (top.edge + index) & minimask;
 }
 
-template<typename T>
-T& Deque<T>::operator[](size_t index) {
+template<typename T, typename Allocator, size_t BlockSize>
+T& Deque<T, Allocator, BlockSize>::operator[](size_t index) {
     return dq[get_apos(index)][get_minipos(index)];
 }
-template<typename T>
-const T &Deque<T>::operator[](size_t index) const {
+template<typename T, typename Allocator, size_t BlockSize>
+const T &Deque<T, Allocator, BlockSize>::operator[](size_t index) const {
     return dq[get_apos(index)][get_minipos(index)];
 }
 
-template<typename T>
-T &Deque<T>::at(size_t index) {
+template<typename T, typename Allocator, size_t BlockSize>
+T &Deque<T, Allocator, BlockSize>::at(size_t index) {
     if (index >= dq_size) {
         throw std::out_of_range("at");
     }
     return dq[get_apos(index)][get_minipos(index)];
 }
-template<typename T>
-const T &Deque<T>::at(size_t index) const {
+template<typename T, typename Allocator, size_t BlockSize>
+const T &Deque<T, Allocator, BlockSize>::at(size_t index) const {
     if (index >= dq_size) {
         throw std::out_of_range("at");
     }
     return dq[get_apos(index)][get_minipos(index)];
 }
 
-template<typename T>
-void Deque<T>::push_back(T val) {
-    if (dq_size > 0) {
-        if (bottom.apos == cap - 1 && bottom.edge == minicap - 1) {
-            reserve(0, cap);
-        }
-        if (bottom.edge == minicap - 1) {
-            ++bottom.apos;
-            bottom.edge = 0;
-        }
-        else {
-            ++bottom.edge;
+template<typename T, typename Allocator, size_t BlockSize>
+template <typename... Args>
+T& Deque<T, Allocator, BlockSize>::emplace_back(Args&&... args) {
+    if (dq == nullptr) {
+        init_map();
+    }
+    miniArray next = bottom;
+    if (dq_size > 0 && bottom.edge == minicap - 1) {
+        if (bottom.apos == cap - 1) {
+            grow_map(false);
         }
+        next = miniArray(bottom.apos + 1, 0);
+    } else if (dq_size > 0) {
+        ++next.edge;
+    }
+    bool new_block = dq[next.apos] == nullptr;
+    if (new_block) {
+        dq[next.apos] = acquire_block();
     }
-    ++dq_size;
     try {
-        new(dq[bottom.apos] + bottom.edge) T(val);
+        AllocTraits::construct(alloc, dq[next.apos] + next.edge, std::forward<Args>(args)...);
     } catch (...) {
-        if (bottom.edge == 0) {
-            --bottom.apos;
-            bottom.edge = minicap - 1;
+        if (new_block) {
+            release_block(dq[next.apos]);
+            dq[next.apos] = nullptr;
         }
-        else {
-            --bottom.edge;
-        }
-        --dq_size;
+        throw;
+    }
+    bottom = next;
+    if (dq_size == 0) {
+        top = next;
     }
+    ++dq_size;
+    return dq[next.apos][next.edge];
 }
 
-template<typename T>
-void Deque<T>::push_front(T val) {
-    if (dq_size > 0) {
-        if (top.apos == 0 && top.edge == 0) {
-            reserve(cap, 0);
-        }
-        if (top.edge == 0) {
-            --top.apos;
-            top.edge = minicap - 1;
-        } else {
-            --top.edge;
-        }
+template<typename T, typename Allocator, size_t BlockSize>
+template <typename... Args>
+T& Deque<T, Allocator, BlockSize>::emplace_front(Args&&... args) {
+    if (dq == nullptr) {
+        init_map();
+    }
+    if (dq_size > 0 && top.apos == 0 && top.edge == 0) {
+        grow_map(true);
+    }
+    miniArray next = top;
+    if (dq_size > 0 && top.edge == 0) {
+        next = miniArray(top.apos - 1, minicap - 1);
+    } else if (dq_size > 0) {
+        --next.edge;
+    }
+    bool new_block = dq[next.apos] == nullptr;
+    if (new_block) {
+        dq[next.apos] = acquire_block();
     }
-    ++dq_size;
     try {
-        new(dq[top.apos] + top.edge) T(val);
+        AllocTraits::construct(alloc, dq[next.apos] + next.edge, std::forward<Args>(args)...);
     } catch (...) {
-        if (top.edge == minicap - 1) {
-            --top.apos;
-            top.edge = 0;
-        } else {
-            --top.edge;
+        if (new_block) {
+            release_block(dq[next.apos]);
+            dq[next.apos] = nullptr;
         }
-        --dq_size;
+        throw;
     }
+    top = next;
+    if (dq_size == 0) {
+        bottom = next;
+    }
+    ++dq_size;
+    return dq[next.apos][next.edge];
 }
 
-template<typename T>
-void Deque<T>::pop_back() {
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::pop_back() {
+    if (dq_size == 0) return;
+    AllocTraits::destroy(alloc, dq[bottom.apos] + bottom.edge);
+    --dq_size;
     if (dq_size == 0) return;
-    (dq[bottom.apos] + bottom.edge)->~T();
     if (bottom.edge == 0) {
+        release_block(dq[bottom.apos]);
+        dq[bottom.apos] = nullptr;
         --bottom.apos;
         bottom.edge = minicap - 1;
     } else {
         --bottom.edge;
     }
-    --dq_size;
 }
 
-template<typename T>
-void Deque<T>::pop_front() {
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::pop_front() {
+    if (dq_size == 0) return;
+    AllocTraits::destroy(alloc, dq[top.apos] + top.edge);
+    --dq_size;
     if (dq_size == 0) return;
-    (dq[top.apos] + top.edge)->~T();
     if (top.edge == minicap - 1) {
+        release_block(dq[top.apos]);
+        dq[top.apos] = nullptr;
         ++top.apos;
         top.edge = 0;
     } else {
         ++top.edge;
     }
-    --dq_size;
 }
 
-template<typename T>
-void Deque<T>::reserve(size_t up_cap, size_t down_cap) {
-    T** ndq = new T*[up_cap + cap + down_cap];
-    size_t exit = 0;
-    try {
-        for (size_t i = 0; i < up_cap + cap + down_cap; ++i) {
-            if (i < up_cap || i >= up_cap + cap)
-                ndq[i] = reinterpret_cast<T*>(new uint8_t[minicap * sizeof(T)]);
-            else ndq[i] = dq[i - up_cap];
-            ++exit;
+template<typename T, typename Allocator, size_t BlockSize>
+template <typename ForwardIt>
+typename Deque<T, Allocator, BlockSize>::iterator
+Deque<T, Allocator, BlockSize>::insert(iterator it, ForwardIt first, ForwardIt last) {
+    size_t idx = it - begin();
+    size_t n = std::distance(first, last);
+    size_t rest = dq_size - idx;
+    if (idx < rest) {
+        // Grow the front by n slots: the new values that land before the old prefix ends
+        // and the first min(n, idx) old elements are constructed there, the rest is shifted.
+        size_t m = std::min(n, idx);
+        ForwardIt mid = first;
+        if (n > idx) {
+            for (size_t i = 0; i < n - idx; ++i, ++mid) {
+                emplace_front(*mid);
+            }
+            std::reverse(begin(), begin() + static_cast<std::ptrdiff_t>(n - idx));
         }
-    } catch (...) {
-        for (size_t i = 0; i < exit; ++i) {
-            delete[] reinterpret_cast<uint8_t*>(ndq[i]);
+        for (size_t i = 0; i < m; ++i) {
+            emplace_front(std::move((*this)[n - 1]));
         }
-        delete[] ndq;
-        throw;
+        if (n <= idx) {
+            move_elements(2 * n, idx - n, n);
+        }
+        std::copy(mid, last, begin() + static_cast<std::ptrdiff_t>(std::max(idx, n)));
+    } else {
+        // Same at the back: the last min(n, rest) old elements and the tail of the new
+        // values are constructed past the end, the rest is shifted.
+        size_t m = std::min(n, rest);
+        size_t old_size = dq_size;
+        ForwardIt mid = last;
+        if (n > rest) {
+            mid = std::next(first, rest);
+            for (ForwardIt p = mid; p != last; ++p) {
+                emplace_back(*p);
+            }
+        }
+        for (size_t i = old_size - m; i < old_size; ++i) {
+            emplace_back(std::move((*this)[i]));
+        }
+        if (n <= rest) {
+            move_elements(idx, rest - n, idx + n);
+        }
+        std::copy(first, mid, begin() + static_cast<std::ptrdiff_t>(idx));
     }
-    delete dq;
-    dq = ndq;
-    cap = up_cap + cap + down_cap;
-    top.apos += up_cap;
-    bottom.apos += up_cap;
+    return begin() + static_cast<std::ptrdiff_t>(idx);
 }
 
-template<typename T>
-Deque<T>::Deque(int n, const T& val): dq_size(n), top(0, 0), bottom(0, minicap - 1) {
-    auto m = static_cast<size_t>(n);
-    if (m > minicap) {
-        cap = (m + minicap - 1) / minicap;
-        top = miniArray(0, 0);
-        bottom = miniArray(cap - 1, (m - 1) % minicap);
+template<typename T, typename Allocator, size_t BlockSize>
+typename Deque<T, Allocator, BlockSize>::iterator
+Deque<T, Allocator, BlockSize>::erase(iterator first, iterator last) {
+    size_t idx = first - begin();
+    size_t n = last - first;
+    if (idx < dq_size - idx - n) {
+        move_elements(0, idx, n);
+        for (size_t i = 0; i < n; ++i) {
+            pop_front();
+        }
     } else {
-        cap = 4;
-        top = miniArray(0, minicap - m);
-        bottom = miniArray(0, minicap - 1);
+        move_elements(idx + n, dq_size - idx - n, idx);
+        for (size_t i = 0; i < n; ++i) {
+            pop_back();
+        }
     }
-    dq = new T*[cap];
-    size_t exit = 0, exi = 0, exj = 0;
-    try {
-        for (size_t i = 0; i < cap; ++i) {
-            dq[i] = reinterpret_cast<T*>(new uint8_t[minicap * sizeof(T)]);
-            ++exit;
-        }
-        for (size_t j = top.edge; j < minicap; ++j) {
-            new(dq[top.apos] + j) T(val);
-            exj = j + 1;
-        }
-        for (size_t i = top.apos + 1; i < bottom.apos; ++i) {
-            for (size_t j = 0; j < minicap; ++j) {
-                new(dq[i] + j) T(val);
-                exj = j + 1;
-            }
-            exi = i + 1;
+    return begin() + static_cast<std::ptrdiff_t>(idx);
+}
+
+// Moves count elements starting at index from to index to, one contiguous run at a time,
+// so that trivially copyable types are shifted with memmove.
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::move_elements(size_t from, size_t count, size_t to) {
+    if (to < from) {
+        while (count > 0) {
+            size_t run = std::min({count, minicap - get_minipos(from), minicap - get_minipos(to)});
+            T* src = &(*this)[from];
+            std::move(src, src + run, &(*this)[to]);
+            from += run;
+            to += run;
+            count -= run;
+        }
+    } else if (to > from) {
+        while (count > 0) {
+            size_t run = std::min({count, get_minipos(from + count - 1) + 1, get_minipos(to + count - 1) + 1});
+            T* src = &(*this)[from + count - 1] + 1;
+            std::move_backward(src - run, src, &(*this)[to + count - 1] + 1);
+            count -= run;
         }
-        if (bottom.apos != top.apos) {
-            for (size_t j = 0; j <= bottom.edge; ++j) {
-                new(dq[bottom.apos] + j) T(val);
-                exj = j + 1;
-            }
+    }
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+T* Deque<T, Allocator, BlockSize>::allocate_block() {
+    BlockAlloc block_alloc(alloc);
+    return reinterpret_cast<T*>(BlockTraits::allocate(block_alloc, 1));
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::deallocate_block(T* block) {
+    BlockAlloc block_alloc(alloc);
+    BlockTraits::deallocate(block_alloc, reinterpret_cast<Block*>(block), 1);
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+T* Deque<T, Allocator, BlockSize>::acquire_block() {
+    if (spare == nullptr) {
+        return allocate_block();
+    }
+    T* block = spare;
+    spare = *reinterpret_cast<T**>(block);
+    --spare_count;
+    return block;
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::release_block(T* block) {
+    if (spare_count == deque_spare_blocks) {
+        deallocate_block(block);
+        return;
+    }
+    *reinterpret_cast<T**>(block) = spare;
+    spare = block;
+    ++spare_count;
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::release_spare() {
+    while (spare != nullptr) {
+        T* next = *reinterpret_cast<T**>(spare);
+        deallocate_block(spare);
+        spare = next;
+    }
+    spare_count = 0;
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+T** Deque<T, Allocator, BlockSize>::allocate_map(size_t n) {
+    MapAlloc map_alloc(alloc);
+    T** map = MapTraits::allocate(map_alloc, n);
+    std::fill(map, map + n, nullptr);
+    return map;
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::deallocate_map(T** map, size_t n) {
+    MapAlloc map_alloc(alloc);
+    MapTraits::deallocate(map_alloc, map, n);
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::destroy_elements() {
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+        for (size_t i = 0; i < dq_size; ++i) {
+            AllocTraits::destroy(alloc, &(*this)[i]);
         }
-    } catch (...) {
-        for (size_t j = top.edge; j < (exi == top.apos ? exj : minicap); ++j) {
-            (dq[top.apos] + j)->~T();
+    }
+    dq_size = 0;
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::free_storage() {
+    if (dq == nullptr) return;
+    destroy_elements();
+    for (size_t i = 0; i < cap; ++i) {
+        if (dq[i] != nullptr) {
+            deallocate_block(dq[i]);
+        }
+    }
+    release_spare();
+    deallocate_map(dq, cap);
+    dq = nullptr;
+    cap = 0;
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::swap_storage(Deque& other) {
+    std::swap(dq, other.dq);
+    std::swap(dq_size, other.dq_size);
+    std::swap(cap, other.cap);
+    miniArray::swap(top, other.top);
+    miniArray::swap(bottom, other.bottom);
+    std::swap(spare, other.spare);
+    std::swap(spare_count, other.spare_count);
+}
+
+// Builds the storage for n elements; each element is constructed from args
+// (or copied from the corresponding element, when the single argument is a Deque).
+template<typename T, typename Allocator, size_t BlockSize>
+template <typename... Args>
+void Deque<T, Allocator, BlockSize>::fill(size_t n, const Args&... args) {
+    if (n == 0) return;
+    size_t blocks = (n + minicap - 1) / minicap;
+    cap = blocks < 4 ? 4 : blocks;
+    top = miniArray(0, 0);
+    bottom = miniArray((n - 1) / minicap, (n - 1) % minicap);
+    dq = allocate_map(cap);
+    try {
+        for (size_t i = 0; i < blocks; ++i) {
+            dq[i] = allocate_block();
         }
-        for (size_t i = top.apos + 1; i < exi; ++i) {
-            for (size_t j = 0; j < minicap; ++j) {
-                (dq[i] + j)->~T();
+        if constexpr (std::is_trivially_copyable_v<T> && sizeof...(Args) == 1
+                      && !(std::is_same_v<Args, Deque> || ...)) {
+            for (size_t i = 0; i < blocks; ++i) {
+                std::uninitialized_fill(dq[i], dq[i] + std::min(minicap, n - i * minicap), args...);
             }
+            dq_size = n;
         }
-        if (exi != top.apos) {
-            for (size_t j = 0; j < exj; ++j) {
-                (dq[exi] + j)->~T();
+        for (; dq_size < n; ++dq_size) {
+            if constexpr (sizeof...(Args) == 1 && (std::is_same_v<Args, Deque> && ...)) {
+                AllocTraits::construct(alloc, &(*this)[dq_size], args[dq_size]...);
+            } else {
+                AllocTraits::construct(alloc, &(*this)[dq_size], args...);
             }
         }
-        for (size_t i = 0; i < exit; ++i) {
-            delete[] reinterpret_cast<uint8_t*>(dq[i]);
+    } catch (...) {
+        free_storage();
+        throw;
+    }
+}
+
+// Copies a deque of trivially copyable elements block by block, keeping its layout.
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::copy_blocks(const Deque& copy) {
+    if (copy.dq_size == 0) return;
+    cap = copy.cap;
+    top = copy.top;
+    bottom = copy.bottom;
+    dq = allocate_map(cap);
+    try {
+        for (size_t i = top.apos; i <= bottom.apos; ++i) {
+            dq[i] = allocate_block();
         }
-        delete[] dq;
+    } catch (...) {
+        free_storage();
         throw;
     }
-}
\ No newline at end of file
+    for (size_t i = top.apos; i <= bottom.apos; ++i) {
+        size_t first = i == top.apos ? top.edge : 0;
+        size_t last = i == bottom.apos ? bottom.edge + 1 : minicap;
+        std::memcpy(dq[i] + first, copy.dq[i] + first, (last - first) * sizeof(T));
+    }
+    dq_size = copy.dq_size;
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::init_map() {
+    cap = 4;
+    dq = allocate_map(cap);
+    top = bottom = miniArray(cap / 2, 0);
+}
+
+// Called when one end of the map is reached. If the map is at least twice as large as
+// the blocks in use (plus the new one), the blocks are just recentred in place;
+// otherwise the map is reallocated growth_factor times larger.
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::grow_map(bool at_front) {
+    size_t needed = bottom.apos - top.apos + 2;
+    if (cap > 2 * needed) {
+        reallocate_map(cap, at_front);
+    } else {
+        auto grown = static_cast<size_t>(static_cast<double>(cap) * growth);
+        reallocate_map(std::max(grown, 2 * needed + 1), at_front);
+    }
+}
+
+// Places the used blocks in the middle of a map of new_cap slots (the current one, when
+// new_cap == cap), leaving one more free slot on the side that is about to grow.
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::reallocate_map(size_t new_cap, bool at_front) {
+    size_t used = bottom.apos - top.apos + 1;
+    size_t new_top = (new_cap - used) / 2 + (at_front ? 1 : 0);
+    if (new_top + used > new_cap) {
+        new_top = new_cap - used;
+    }
+    if (new_cap == cap) {
+        if (new_top < top.apos) {
+            std::copy(dq + top.apos, dq + bottom.apos + 1, dq + new_top);
+            std::fill(dq + std::max(new_top + used, top.apos), dq + bottom.apos + 1, nullptr);
+        } else if (new_top > top.apos) {
+            std::copy_backward(dq + top.apos, dq + bottom.apos + 1, dq + new_top + used);
+            std::fill(dq + top.apos, dq + std::min(new_top, bottom.apos + 1), nullptr);
+        }
+    } else {
+        T** ndq = allocate_map(new_cap);
+        std::copy(dq + top.apos, dq + bottom.apos + 1, ndq + new_top);
+        deallocate_map(dq, cap);
+        dq = ndq;
+        cap = new_cap;
+    }
+    bottom.apos = bottom.apos - top.apos + new_top;
+    top.apos = new_top;
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::reserve(size_t n) {
+    size_t new_cap = 2 * ((n + minicap - 1) / minicap + 2);
+    if (dq == nullptr) {
+        init_map();
+    }
+    if (new_cap > cap) {
+        reallocate_map(new_cap, false);
+    }
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+typename Deque<T, Allocator, BlockSize>::MemoryUsage Deque<T, Allocator, BlockSize>::memory_usage() const {
+    MemoryUsage usage;
+    usage.map_bytes = cap * sizeof(T*);
+    if (dq != nullptr) {
+        usage.live_blocks = std::count_if(dq + top.apos, dq + bottom.apos + 1, [](T* block) {
+            return block != nullptr;
+        });
+    }
+    usage.spare_blocks = spare_count;
+    usage.block_bytes = (usage.live_blocks + usage.spare_blocks) * sizeof(Block);
+    usage.wasted_slots = usage.live_blocks * minicap - dq_size;
+    return usage;
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+void Deque<T, Allocator, BlockSize>::shrink_to_fit() {
+    release_spare();
+    if (dq_size == 0) {
+        free_storage();
+        top = bottom = miniArray(0, 0);
+        return;
+    }
+    size_t new_cap = std::max<size_t>(4, bottom.apos - top.apos + 3);
+    if (new_cap < cap) {
+        reallocate_map(new_cap, false);
+    }
+}
+
+template<typename T, typename Allocator, size_t BlockSize>
+Deque<T, Allocator, BlockSize>::Deque(size_t n, const T& val, const Allocator& al): top(0, 0), bottom(0, 0), alloc(al) {
+    fill(static_cast<size_t>(n), val);
+}
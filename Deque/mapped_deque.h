@@ -0,0 +1,253 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "deque.h"
+
+// Deque of trivially copyable elements kept in a memory-mapped file (POSIX only), for
+// queues larger than RAM: the OS pages cold blocks out and keeps the ones near the ends
+// resident. Opening an existing file resumes the queue where it was left.
+//
+// The file is a one-page header followed by a ring of blocks. Elements are addressed by
+// 64-bit logical indices that start in the middle of the range, so both ends can grow
+// without wrapping; element i lives in ring slot i % capacity. When the ring is full it
+// is doubled and the elements whose slot changes are copied to the new half. The header
+// is updated only once the copy is on disk, so a crash during growth leaves the old layout
+// intact.
+//
+// flush() writes everything to disk. Without it the data still reaches the file once the
+// kernel writes the pages back, but a power loss may lose the latest changes.
+template <typename T, size_t BlockSize = deque_block_size<T>()>
+class MappedDeque {
+    static_assert(std::is_trivially_copyable_v<T>, "MappedDeque requires a trivially copyable T");
+    static_assert(std::has_single_bit(BlockSize), "MappedDeque block size must be a power of two");
+private:
+    constexpr static size_t minicap = BlockSize;
+    constexpr static size_t header_bytes = 4096;
+    constexpr static uint64_t file_magic = 0x4d41505044455155;    // "MAPPDEQU"
+    constexpr static uint32_t file_version = 1;
+
+    struct Header {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t elem_size;
+        uint64_t block_size;
+        uint64_t blocks;
+        uint64_t head;
+        uint64_t tail;
+    };
+    static_assert(sizeof(Header) <= header_bytes);
+
+    int fd = -1;
+    uint8_t* base = nullptr;
+    size_t mapped_bytes = 0;
+
+    Header* header() const {
+        return reinterpret_cast<Header*>(base);
+    }
+    T* data() const {
+        return reinterpret_cast<T*>(base + header_bytes);
+    }
+    size_t capacity() const {
+        return header()->blocks * minicap;
+    }
+    T* slot(uint64_t index) const {
+        return data() + index % capacity();
+    }
+    void map(size_t bytes);
+    void unmap();
+    void sync(size_t offset, size_t bytes);
+    void grow();
+
+public:
+    // Opens the queue stored at path, creating the file if it does not exist yet.
+    explicit MappedDeque(const std::string& path, size_t initial_blocks = 16);
+    MappedDeque(const MappedDeque&) = delete;
+    MappedDeque& operator=(const MappedDeque&) = delete;
+    ~MappedDeque() {
+        unmap();
+        if (fd != -1) {
+            ::close(fd);
+        }
+    }
+
+    T& operator[](size_t index) {
+        return *slot(header()->head + index);
+    }
+    const T& operator[](size_t index) const {
+        return *slot(header()->head + index);
+    }
+    T& at(size_t index);
+    const T& at(size_t index) const;
+    size_t size() const {
+        return header()->tail - header()->head;
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+
+    void push_back(const T& val);
+    void push_front(const T& val);
+    void pop_back();
+    void pop_front();
+
+    // Synchronously writes the mapped pages and the header to the file.
+    void flush();
+};
+
+template <typename T, size_t BlockSize>
+MappedDeque<T, BlockSize>::MappedDeque(const std::string& path, size_t initial_blocks) {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "open " + path);
+    }
+    try {
+        struct stat st;
+        if (::fstat(fd, &st) == -1) {
+            throw std::system_error(errno, std::generic_category(), "fstat " + path);
+        }
+        if (st.st_size == 0) {
+            size_t blocks = initial_blocks < 1 ? 1 : initial_blocks;
+            size_t bytes = header_bytes + blocks * minicap * sizeof(T);
+            if (::ftruncate(fd, static_cast<off_t>(bytes)) == -1) {
+                throw std::system_error(errno, std::generic_category(), "ftruncate " + path);
+            }
+            map(bytes);
+            *header() = Header{file_magic, file_version, sizeof(T), minicap, blocks, uint64_t(1) << 62, uint64_t(1) << 62};
+        } else {
+            if (static_cast<size_t>(st.st_size) < header_bytes) {
+                throw std::runtime_error("MappedDeque: " + path + " is not a queue file");
+            }
+            map(static_cast<size_t>(st.st_size));
+            const Header& h = *header();
+            if (h.magic != file_magic || h.version != file_version) {
+                throw std::runtime_error("MappedDeque: " + path + " is not a queue file");
+            }
+            if (h.elem_size != sizeof(T) || h.block_size != minicap) {
+                throw std::runtime_error("MappedDeque: " + path + " was written for a different element or block size");
+            }
+            if (header_bytes + h.blocks * minicap * sizeof(T) > mapped_bytes || h.tail - h.head > capacity()) {
+                throw std::runtime_error("MappedDeque: " + path + " is truncated or corrupt");
+            }
+        }
+    } catch (...) {
+        unmap();
+        ::close(fd);
+        throw;
+    }
+}
+
+// Replaces the current mapping, if any, with one of the first bytes of the file. The new
+// mapping is made before the old one is dropped, so on failure the old one is still intact.
+template <typename T, size_t BlockSize>
+void MappedDeque<T, BlockSize>::map(size_t bytes) {
+    void* p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mmap");
+    }
+    unmap();
+    base = static_cast<uint8_t*>(p);
+    mapped_bytes = bytes;
+}
+
+template <typename T, size_t BlockSize>
+void MappedDeque<T, BlockSize>::unmap() {
+    if (base != nullptr) {
+        ::munmap(base, mapped_bytes);
+        base = nullptr;
+        mapped_bytes = 0;
+    }
+}
+
+template <typename T, size_t BlockSize>
+void MappedDeque<T, BlockSize>::sync(size_t offset, size_t bytes) {
+    if (::msync(base + offset, bytes, MS_SYNC) == -1) {
+        throw std::system_error(errno, std::generic_category(), "msync");
+    }
+}
+
+// Doubles the ring. With capacity c, element i moves from slot i % c to slot i % 2c,
+// which is either the same slot or the same slot plus c, so it is copied in runs that
+// stay contiguous on both sides.
+template <typename T, size_t BlockSize>
+void MappedDeque<T, BlockSize>::grow() {
+    size_t old_cap = capacity();
+    size_t new_cap = old_cap * 2;
+    size_t bytes = header_bytes + new_cap * sizeof(T);
+    if (::ftruncate(fd, static_cast<off_t>(bytes)) == -1) {
+        throw std::system_error(errno, std::generic_category(), "ftruncate");
+    }
+    map(bytes);
+    uint64_t i = header()->head;
+    uint64_t end = header()->tail;
+    while (i < end) {
+        size_t from = i % old_cap;
+        size_t to = i % new_cap;
+        size_t run = std::min<uint64_t>({end - i, old_cap - from, new_cap - to});
+        if (from != to) {
+            std::memcpy(data() + to, data() + from, run * sizeof(T));
+        }
+        i += run;
+    }
+    // The copies have to be on disk before the header that refers to them.
+    sync(header_bytes, new_cap * sizeof(T));
+    header()->blocks *= 2;
+    sync(0, header_bytes);
+}
+
+template <typename T, size_t BlockSize>
+T& MappedDeque<T, BlockSize>::at(size_t index) {
+    if (index >= size()) {
+        throw std::out_of_range("at");
+    }
+    return (*this)[index];
+}
+template <typename T, size_t BlockSize>
+const T& MappedDeque<T, BlockSize>::at(size_t index) const {
+    if (index >= size()) {
+        throw std::out_of_range("at");
+    }
+    return (*this)[index];
+}
+
+template <typename T, size_t BlockSize>
+void MappedDeque<T, BlockSize>::push_back(const T& val) {
+    if (size() == capacity()) {
+        grow();
+    }
+    std::memcpy(slot(header()->tail), &val, sizeof(T));
+    ++header()->tail;
+}
+
+template <typename T, size_t BlockSize>
+void MappedDeque<T, BlockSize>::push_front(const T& val) {
+    if (size() == capacity()) {
+        grow();
+    }
+    std::memcpy(slot(header()->head - 1), &val, sizeof(T));
+    --header()->head;
+}
+
+template <typename T, size_t BlockSize>
+void MappedDeque<T, BlockSize>::pop_back() {
+    if (size() == 0) return;
+    --header()->tail;
+}
+
+template <typename T, size_t BlockSize>
+void MappedDeque<T, BlockSize>::pop_front() {
+    if (size() == 0) return;
+    ++header()->head;
+}
+
+template <typename T, size_t BlockSize>
+void MappedDeque<T, BlockSize>::flush() {
+    sync(0, mapped_bytes);
+}
@@ -0,0 +1,186 @@
+#pragma once
+#include <exception>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "deque.h"
+
+// Parallel for_each, transform, reduce and sort over a Deque. The blocks are split into
+// one run of whole blocks per thread, so every thread walks contiguous memory and no two
+// threads write to the same block. Work is forked onto std::threads and joined before
+// returning: with libstdc++ std::execution::par needs TBB, which we don't want to depend on.
+//
+// threads == 0 means one thread per hardware core. The calling thread takes the first run.
+// If a callback throws, the first exception (in element order) is rethrown after all
+// threads have finished.
+
+inline size_t deque_parallel_threads(size_t threads) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    return threads == 0 ? 1 : threads;
+}
+
+// A run of whole blocks and the index of its first element.
+template <typename Span>
+struct DequeChunk {
+    const Span* first;
+    const Span* last;
+    size_t offset;
+    size_t size() const {
+        size_t n = 0;
+        for (const Span* seg = first; seg != last; ++seg) {
+            n += seg->size();
+        }
+        return n;
+    }
+};
+
+template <typename Span>
+std::vector<DequeChunk<Span>> deque_split(const std::vector<Span>& segs, size_t threads) {
+    size_t n = std::min(deque_parallel_threads(threads), segs.size());
+    std::vector<DequeChunk<Span>> chunks;
+    chunks.reserve(n);
+    size_t offset = 0;
+    for (size_t k = 0; k < n; ++k) {
+        DequeChunk<Span> chunk{segs.data() + k * segs.size() / n, segs.data() + (k + 1) * segs.size() / n, offset};
+        offset += chunk.size();
+        chunks.push_back(chunk);
+    }
+    return chunks;
+}
+
+// Runs f(k, tasks[k]) for every task, the first one on the calling thread.
+template <typename Task, typename F>
+void deque_run_parallel(const std::vector<Task>& tasks, F f) {
+    std::vector<std::exception_ptr> errors(tasks.size());
+    auto run = [&](size_t k) {
+        try {
+            f(k, tasks[k]);
+        } catch (...) {
+            errors[k] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> workers;
+    workers.reserve(tasks.size());
+    try {
+        for (size_t k = 1; k < tasks.size(); ++k) {
+            workers.emplace_back(run, k);
+        }
+    } catch (...) {
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        throw;
+    }
+    if (!tasks.empty()) {
+        run(0);
+    }
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+    for (std::exception_ptr& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+// f is shared by all threads.
+template <typename T, typename Allocator, size_t BlockSize, typename F>
+void parallel_for_each(Deque<T, Allocator, BlockSize>& d, F f, size_t threads = 0) {
+    std::vector<std::span<T>> segs(d.segments().begin(), d.segments().end());
+    deque_run_parallel(deque_split(segs, threads), [&f](size_t, const DequeChunk<std::span<T>>& chunk) {
+        for (const std::span<T>* seg = chunk.first; seg != chunk.last; ++seg) {
+            for (T& x : *seg) {
+                f(x);
+            }
+        }
+    });
+}
+
+// out[i] = f(in[i]); out has to be as long as in and may be the same deque. The runs are
+// cut on out's blocks, the ones written to; in is only read and its blocks may be shared
+// between threads when the two deques are laid out differently.
+template <typename T, typename Allocator, size_t BlockSize,
+          typename U, typename OutAllocator, size_t OutBlockSize, typename F>
+void parallel_transform(const Deque<T, Allocator, BlockSize>& in, Deque<U, OutAllocator, OutBlockSize>& out,
+                        F f, size_t threads = 0) {
+    if (out.size() != in.size()) {
+        throw std::length_error("parallel_transform");
+    }
+    std::vector<std::span<U>> segs(out.segments().begin(), out.segments().end());
+    deque_run_parallel(deque_split(segs, threads), [&f, &in](size_t, const DequeChunk<std::span<U>>& chunk) {
+        auto src = in.begin() + static_cast<std::ptrdiff_t>(chunk.offset);
+        for (const std::span<U>* seg = chunk.first; seg != chunk.last; ++seg) {
+            for (U& y : *seg) {
+                y = f(*src);
+                ++src;
+            }
+        }
+    });
+}
+
+// op has to be associative: the runs are reduced separately and combined in order.
+template <typename T, typename Allocator, size_t BlockSize, typename U, typename BinaryOp = std::plus<>>
+U parallel_reduce(const Deque<T, Allocator, BlockSize>& d, U init, BinaryOp op = BinaryOp(), size_t threads = 0) {
+    std::vector<std::span<const T>> segs(d.segments().begin(), d.segments().end());
+    auto chunks = deque_split(segs, threads);
+    std::vector<std::optional<U>> partial(chunks.size());
+    deque_run_parallel(chunks, [&op, &partial](size_t k, const DequeChunk<std::span<const T>>& chunk) {
+        std::optional<U>& acc = partial[k];
+        for (const std::span<const T>* seg = chunk.first; seg != chunk.last; ++seg) {
+            for (const T& x : *seg) {
+                if (acc) {
+                    *acc = op(std::move(*acc), x);
+                } else {
+                    acc.emplace(x);
+                }
+            }
+        }
+    });
+    for (std::optional<U>& acc : partial) {
+        if (acc) {
+            init = op(std::move(init), std::move(*acc));
+        }
+    }
+    return init;
+}
+
+// Sorts every run on its own thread, then merges neighbouring runs pairwise,
+// halving the number of runs (and of busy threads) in each round.
+template <typename T, typename Allocator, size_t BlockSize, typename Compare = std::less<>>
+void parallel_sort(Deque<T, Allocator, BlockSize>& d, Compare comp = Compare(), size_t threads = 0) {
+    std::vector<std::span<T>> segs(d.segments().begin(), d.segments().end());
+    auto chunks = deque_split(segs, threads);
+    std::vector<size_t> bounds;
+    for (const DequeChunk<std::span<T>>& chunk : chunks) {
+        bounds.push_back(chunk.offset);
+    }
+    bounds.push_back(d.size());
+    auto at = [&d](size_t index) {
+        return d.begin() + static_cast<std::ptrdiff_t>(index);
+    };
+    deque_run_parallel(chunks, [&](size_t k, const DequeChunk<std::span<T>>&) {
+        std::sort(at(bounds[k]), at(bounds[k + 1]), comp);
+    });
+    while (bounds.size() > 2) {
+        std::vector<size_t> merges;
+        for (size_t k = 0; k + 2 < bounds.size(); k += 2) {
+            merges.push_back(k);
+        }
+        deque_run_parallel(merges, [&](size_t, size_t k) {
+            std::inplace_merge(at(bounds[k]), at(bounds[k + 1]), at(bounds[k + 2]), comp);
+        });
+        std::vector<size_t> merged;
+        for (size_t k = 0; k < bounds.size(); k += 2) {
+            merged.push_back(bounds[k]);
+        }
+        if (merged.back() != bounds.back()) {
+            merged.push_back(bounds.back());
+        }
+        bounds = std::move(merged);
+    }
+}
@@ -0,0 +1,564 @@
+#pragma once
+#include <iterator>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include "deque.h"
+
+// Deque with an inline ring buffer of InlineCapacity elements. As long as the elements fit
+// in the ring no memory is allocated and operator[] is one add and one compare away from
+// the element. The first push that does not fit moves everything into a segmented Deque,
+// which then serves all operations; shrink_to_fit moves the elements back into the ring
+// once they fit again.
+//
+// Ring elements are not allocated through the allocator, so they are constructed and
+// destroyed directly rather than through AllocTraits.
+template <typename T, size_t InlineCapacity, typename Allocator = std::allocator<T>,
+          size_t BlockSize = deque_block_size<T>()>
+class SmallDeque {
+    static_assert(InlineCapacity > 0, "SmallDeque inline capacity must be positive");
+private:
+    using Big = Deque<T, Allocator, BlockSize>;
+    constexpr static size_t ringcap = InlineCapacity;
+
+    alignas(T) uint8_t ring[ringcap * sizeof(T)];
+    size_t head = 0;
+    size_t ring_size = 0;
+    bool small = true;
+    Big big;
+
+    T* ring_data() {
+        return reinterpret_cast<T*>(ring);
+    }
+    const T* ring_data() const {
+        return reinterpret_cast<const T*>(ring);
+    }
+    // Both head and index are below ringcap, so one subtraction wraps the position.
+    size_t ring_pos(size_t index) const {
+        size_t pos = head + index;
+        return pos < ringcap ? pos : pos - ringcap;
+    }
+    void destroy_ring();
+    void copy_ring(const SmallDeque& other);
+    void move_ring(SmallDeque& other);
+    void spill();
+
+public:
+    using AllocTraits = std::allocator_traits<Allocator>;
+
+    SmallDeque(): SmallDeque(Allocator()) {}
+    explicit SmallDeque(const Allocator& al): big(al) {}
+
+    SmallDeque(const SmallDeque& copy): big(AllocTraits::select_on_container_copy_construction(copy.get_allocator())) {
+        if (copy.small) {
+            copy_ring(copy);
+        } else {
+            big = Big(copy.big, big.get_allocator());
+            small = false;
+        }
+    }
+
+    SmallDeque(SmallDeque&& other) noexcept(std::is_nothrow_move_constructible_v<T>):
+            small(other.small), big(std::move(other.big)) {
+        if (small) {
+            move_ring(other);
+        }
+        other.small = true;
+    }
+
+    explicit SmallDeque(size_t n, const T& val = T(), const Allocator& al = Allocator());
+
+    SmallDeque& operator=(const SmallDeque& c) {
+        if (this == &c) return *this;
+        destroy_ring();
+        big = c.big;
+        small = c.small;
+        if (small) {
+            copy_ring(c);
+        }
+        return *this;
+    }
+
+    SmallDeque& operator=(SmallDeque&& other) noexcept(std::is_nothrow_move_assignable_v<Big>
+                                                       && std::is_nothrow_move_constructible_v<T>) {
+        if (this == &other) return *this;
+        destroy_ring();
+        big = std::move(other.big);
+        small = other.small;
+        if (small) {
+            move_ring(other);
+        }
+        other.small = true;
+        return *this;
+    }
+
+    ~SmallDeque() {
+        destroy_ring();
+    }
+
+    Allocator get_allocator() const {
+        return big.get_allocator();
+    }
+
+    T& operator[](size_t index) {
+        return small ? ring_data()[ring_pos(index)] : big[index];
+    }
+    const T& operator[](size_t index) const {
+        return small ? ring_data()[ring_pos(index)] : big[index];
+    }
+    T& at(size_t index);
+    const T& at(size_t index) const;
+    size_t size() const {
+        return small ? ring_size : big.size();
+    }
+    // Whether the elements currently live in the inline ring.
+    bool is_inline() const {
+        return small;
+    }
+
+    template <typename... Args>
+    T& emplace_back(Args&&... args);
+    template <typename... Args>
+    T& emplace_front(Args&&... args);
+    void push_back(const T& val) {
+        emplace_back(val);
+    }
+    void push_back(T&& val) {
+        emplace_back(std::move(val));
+    }
+    void push_front(const T& val) {
+        emplace_front(val);
+    }
+    void push_front(T&& val) {
+        emplace_front(std::move(val));
+    }
+    void pop_back();
+    void pop_front();
+
+    // Reserving more than the ring holds moves the elements to the segmented storage right away.
+    void reserve(size_t n);
+    void shrink_to_fit();
+    typename Big::MemoryUsage memory_usage() const {
+        return big.memory_usage();
+    }
+
+    // Calls f with the elements as contiguous spans: at most two for the ring,
+    // one per block otherwise.
+    template <typename F>
+    void for_each_segment(F f);
+    template <typename F>
+    void for_each_segment(F f) const;
+
+    template<bool is_const>
+    class Iter;
+
+    using const_iterator = Iter<true>;
+    using iterator = Iter<false>;
+    using const_reverse_iterator = std::reverse_iterator<Iter<true>>;
+    using reverse_iterator = std::reverse_iterator<Iter<false>>;
+
+    iterator begin() {
+        return iterator(this, 0);
+    }
+    iterator end() {
+        return iterator(this, size());
+    }
+
+    const_iterator begin() const {
+        return const_iterator(this, 0);
+    }
+    const_iterator end() const {
+        return const_iterator(this, size());
+    }
+
+    const_iterator cbegin() const {
+        return const_iterator(this, 0);
+    }
+    const_iterator cend() const {
+        return const_iterator(this, size());
+    }
+
+    reverse_iterator rbegin() {
+        return std::reverse_iterator(end());
+    };
+    const_reverse_iterator rbegin() const {
+        return std::reverse_iterator(cend());
+    };
+    const_reverse_iterator crbegin() const {
+        return std::reverse_iterator(cend());
+    };
+
+    reverse_iterator rend() {
+        return std::reverse_iterator(begin());
+    };
+    const_reverse_iterator rend() const {
+        return std::reverse_iterator(cbegin());
+    };
+    const_reverse_iterator crend() const {
+        return std::reverse_iterator(cbegin());
+    };
+
+    iterator insert(iterator it, const T& val) {
+        T tmp(val);
+        return insert(it, std::make_move_iterator(&tmp), std::make_move_iterator(&tmp + 1));
+    }
+    iterator insert(iterator it, T&& val) {
+        return insert(it, std::make_move_iterator(&val), std::make_move_iterator(&val + 1));
+    }
+    template <typename ForwardIt>
+    iterator insert(iterator it, ForwardIt first, ForwardIt last);
+
+    iterator erase(iterator it) {
+        return erase(it, it + 1);
+    }
+    iterator erase(iterator first, iterator last);
+};
+
+// Iterators hold an index rather than a position, so they work the same in both modes.
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+template <bool is_const>
+class SmallDeque<T, InlineCapacity, Allocator, BlockSize>::Iter {
+private:
+    using deque_pointer = std::conditional_t<is_const, const SmallDeque*, SmallDeque*>;
+    deque_pointer d = nullptr;
+    size_t index = 0;
+public:
+    using difference_type = std::ptrdiff_t;
+    using value_type = T;
+    using iterator_category = std::random_access_iterator_tag;
+    using reference = std::conditional_t<is_const, const T&, T&>;
+    using pointer = std::conditional_t<is_const, const T*, T*>;
+    Iter() = default;
+    Iter(deque_pointer d, size_t index): d(d), index(index) {}
+    operator Iter<true>() const {
+        return Iter<true>(d, index);
+    }
+    Iter& operator++() {
+        ++index;
+        return *this;
+    }
+    Iter& operator--() {
+        --index;
+        return *this;
+    }
+    Iter operator++(int) {
+        Iter it = *this;
+        ++index;
+        return it;
+    }
+    Iter operator--(int) {
+        Iter it = *this;
+        --index;
+        return it;
+    }
+    Iter operator+(difference_type n) const {
+        return Iter(d, index + n);
+    }
+    Iter operator-(difference_type n) const {
+        return Iter(d, index - n);
+    }
+    Iter& operator+=(difference_type n) {
+        index += n;
+        return *this;
+    }
+    Iter& operator-=(difference_type n) {
+        index -= n;
+        return *this;
+    }
+    friend Iter operator+(difference_type n, const Iter& it) {
+        return it + n;
+    }
+    reference operator[](difference_type n) const {
+        return (*d)[index + n];
+    }
+
+    difference_type operator-(const Iter& it) const {
+        return static_cast<difference_type>(index) - static_cast<difference_type>(it.index);
+    }
+
+    bool operator==(const Iter& it) const {
+        return index == it.index;
+    }
+    bool operator!=(const Iter& it) const {
+        return index != it.index;
+    }
+    bool operator<(const Iter& it) const {
+        return index < it.index;
+    }
+    bool operator>=(const Iter& it) const {
+        return index >= it.index;
+    }
+    bool operator>(const Iter& it) const {
+        return index > it.index;
+    }
+    bool operator<=(const Iter& it) const {
+        return index <= it.index;
+    }
+    reference operator*() const {
+        return (*d)[index];
+    }
+    pointer operator->() const {
+        return &(*d)[index];
+    }
+};
+
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+SmallDeque<T, InlineCapacity, Allocator, BlockSize>::SmallDeque(size_t n, const T& val, const Allocator& al): big(al) {
+    if (n <= ringcap) {
+        for (; ring_size < n; ++ring_size) {
+            try {
+                std::construct_at(ring_data() + ring_size, val);
+            } catch (...) {
+                destroy_ring();
+                throw;
+            }
+        }
+    } else {
+        big = Big(n, val, al);
+        small = false;
+    }
+}
+
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+void SmallDeque<T, InlineCapacity, Allocator, BlockSize>::destroy_ring() {
+    if constexpr (!std::is_trivially_destructible_v<T>) {
+        for (size_t i = 0; i < ring_size; ++i) {
+            std::destroy_at(ring_data() + ring_pos(i));
+        }
+    }
+    head = 0;
+    ring_size = 0;
+}
+
+// Both helpers expect an empty ring and lay the elements out from position 0.
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+void SmallDeque<T, InlineCapacity, Allocator, BlockSize>::copy_ring(const SmallDeque& other) {
+    try {
+        for (; ring_size < other.ring_size; ++ring_size) {
+            std::construct_at(ring_data() + ring_size, other.ring_data()[other.ring_pos(ring_size)]);
+        }
+    } catch (...) {
+        destroy_ring();
+        throw;
+    }
+}
+
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+void SmallDeque<T, InlineCapacity, Allocator, BlockSize>::move_ring(SmallDeque& other) {
+    try {
+        for (; ring_size < other.ring_size; ++ring_size) {
+            std::construct_at(ring_data() + ring_size, std::move(other.ring_data()[other.ring_pos(ring_size)]));
+        }
+    } catch (...) {
+        destroy_ring();
+        throw;
+    }
+    other.destroy_ring();
+}
+
+// Moves the ring into the segmented storage. If that fails, the elements that were
+// already moved out go back, so the deque is left as it was.
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+void SmallDeque<T, InlineCapacity, Allocator, BlockSize>::spill() {
+    try {
+        big.reserve(ring_size + 1);
+        for (size_t i = 0; i < ring_size; ++i) {
+            big.emplace_back(std::move_if_noexcept(ring_data()[ring_pos(i)]));
+        }
+    } catch (...) {
+        if constexpr (std::is_nothrow_move_constructible_v<T>) {
+            for (size_t i = 0; i < big.size(); ++i) {
+                ring_data()[ring_pos(i)] = std::move(big[i]);
+            }
+        }
+        while (big.size() > 0) {
+            big.pop_back();
+        }
+        throw;
+    }
+    destroy_ring();
+    small = false;
+}
+
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+T& SmallDeque<T, InlineCapacity, Allocator, BlockSize>::at(size_t index) {
+    if (index >= size()) {
+        throw std::out_of_range("at");
+    }
+    return (*this)[index];
+}
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+const T& SmallDeque<T, InlineCapacity, Allocator, BlockSize>::at(size_t index) const {
+    if (index >= size()) {
+        throw std::out_of_range("at");
+    }
+    return (*this)[index];
+}
+
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+template <typename... Args>
+T& SmallDeque<T, InlineCapacity, Allocator, BlockSize>::emplace_back(Args&&... args) {
+    if (small && ring_size == ringcap) {
+        // args may refer to an element of the ring, which spill() moves away.
+        T tmp(std::forward<Args>(args)...);
+        spill();
+        return big.emplace_back(std::move(tmp));
+    }
+    if (!small) {
+        return big.emplace_back(std::forward<Args>(args)...);
+    }
+    T* slot = std::construct_at(ring_data() + ring_pos(ring_size), std::forward<Args>(args)...);
+    ++ring_size;
+    return *slot;
+}
+
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+template <typename... Args>
+T& SmallDeque<T, InlineCapacity, Allocator, BlockSize>::emplace_front(Args&&... args) {
+    if (small && ring_size == ringcap) {
+        // args may refer to an element of the ring, which spill() moves away.
+        T tmp(std::forward<Args>(args)...);
+        spill();
+        return big.emplace_front(std::move(tmp));
+    }
+    if (!small) {
+        return big.emplace_front(std::forward<Args>(args)...);
+    }
+    size_t pos = head == 0 ? ringcap - 1 : head - 1;
+    T* slot = std::construct_at(ring_data() + pos, std::forward<Args>(args)...);
+    head = pos;
+    ++ring_size;
+    return *slot;
+}
+
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+void SmallDeque<T, InlineCapacity, Allocator, BlockSize>::pop_back() {
+    if (!small) {
+        big.pop_back();
+        return;
+    }
+    if (ring_size == 0) return;
+    --ring_size;
+    std::destroy_at(ring_data() + ring_pos(ring_size));
+}
+
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+void SmallDeque<T, InlineCapacity, Allocator, BlockSize>::pop_front() {
+    if (!small) {
+        big.pop_front();
+        return;
+    }
+    if (ring_size == 0) return;
+    std::destroy_at(ring_data() + head);
+    head = ring_pos(1);
+    --ring_size;
+}
+
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+void SmallDeque<T, InlineCapacity, Allocator, BlockSize>::reserve(size_t n) {
+    if (small && n > ringcap) {
+        spill();
+    }
+    if (!small) {
+        big.reserve(n);
+    }
+}
+
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+void SmallDeque<T, InlineCapacity, Allocator, BlockSize>::shrink_to_fit() {
+    if (small) return;
+    if constexpr (std::is_nothrow_move_constructible_v<T>) {
+        if (big.size() <= ringcap) {
+            for (; ring_size < big.size(); ++ring_size) {
+                std::construct_at(ring_data() + ring_size, std::move(big[ring_size]));
+            }
+            while (big.size() > 0) {
+                big.pop_back();
+            }
+            small = true;
+        }
+    }
+    big.shrink_to_fit();
+}
+
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+template <typename F>
+void SmallDeque<T, InlineCapacity, Allocator, BlockSize>::for_each_segment(F f) {
+    if (!small) {
+        big.for_each_segment(f);
+        return;
+    }
+    size_t first = std::min(ring_size, ringcap - head);
+    if (first > 0) {
+        f(std::span<T>(ring_data() + head, first));
+    }
+    if (ring_size > first) {
+        f(std::span<T>(ring_data(), ring_size - first));
+    }
+}
+
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+template <typename F>
+void SmallDeque<T, InlineCapacity, Allocator, BlockSize>::for_each_segment(F f) const {
+    if (!small) {
+        big.for_each_segment(f);
+        return;
+    }
+    size_t first = std::min(ring_size, ringcap - head);
+    if (first > 0) {
+        f(std::span<const T>(ring_data() + head, first));
+    }
+    if (ring_size > first) {
+        f(std::span<const T>(ring_data(), ring_size - first));
+    }
+}
+
+// In the ring the new values are appended and rotated into place; once they no longer
+// fit, the elements move to the segmented storage, which inserts as Deque does.
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+template <typename ForwardIt>
+typename SmallDeque<T, InlineCapacity, Allocator, BlockSize>::iterator
+SmallDeque<T, InlineCapacity, Allocator, BlockSize>::insert(iterator it, ForwardIt first, ForwardIt last) {
+    size_t idx = it - begin();
+    size_t n = std::distance(first, last);
+    if (small && ring_size + n > ringcap) {
+        spill();
+    }
+    if (!small) {
+        big.insert(big.begin() + static_cast<std::ptrdiff_t>(idx), first, last);
+        return begin() + idx;
+    }
+    size_t old_size = ring_size;
+    try {
+        for (; first != last; ++first) {
+            emplace_back(*first);
+        }
+    } catch (...) {
+        while (ring_size > old_size) {
+            pop_back();
+        }
+        throw;
+    }
+    std::rotate(begin() + idx, begin() + old_size, end());
+    return begin() + idx;
+}
+
+template <typename T, size_t InlineCapacity, typename Allocator, size_t BlockSize>
+typename SmallDeque<T, InlineCapacity, Allocator, BlockSize>::iterator
+SmallDeque<T, InlineCapacity, Allocator, BlockSize>::erase(iterator first, iterator last) {
+    size_t idx = first - begin();
+    size_t n = last - first;
+    if (n == 0) {
+        return first;
+    }
+    if (!small) {
+        big.erase(big.begin() + static_cast<std::ptrdiff_t>(idx), big.begin() + static_cast<std::ptrdiff_t>(idx + n));
+        return begin() + idx;
+    }
+    std::move(begin() + (idx + n), end(), begin() + idx);
+    for (size_t i = 0; i < n; ++i) {
+        pop_back();
+    }
+    return begin() + idx;
+}
@@ -0,0 +1,232 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include "deque.h"
+
+// Lock-free single-producer/single-consumer queue built from the same fixed-size,
+// cache-line-aligned blocks as Deque. One thread calls push_back/emplace_back/push_bulk,
+// another one calls pop_front/pop_bulk.
+//
+// The blocks are chained through a next pointer instead of a map: the map would have
+// to be reallocated under the consumer. Elements are addressed by monotonic 64-bit
+// counters, head and tail, each on its own cache line. Blocks the consumer is done with
+// go back to the producer through a lock-free return list, so a queue in steady state
+// does not allocate.
+template <typename T, typename Allocator = std::allocator<T>, size_t BlockSize = deque_block_size<T>()>
+class SpscDeque {
+    static_assert(BlockSize > 0, "SpscDeque block size must be positive");
+private:
+    constexpr static size_t minicap = BlockSize;
+    constexpr static size_t block_align = alignof(T) > deque_cache_line ? alignof(T) : deque_cache_line;
+    struct alignas(block_align) Block {
+        uint8_t bytes[minicap * sizeof(T)];
+        std::atomic<Block*> next{nullptr};
+        T* data() {
+            return reinterpret_cast<T*>(bytes);
+        }
+    };
+
+public:
+    using AllocTraits = std::allocator_traits<Allocator>;
+    using BlockAlloc = typename AllocTraits::template rebind_alloc<Block>;
+    using BlockTraits = std::allocator_traits<BlockAlloc>;
+
+private:
+    // Producer side.
+    struct alignas(deque_cache_line) {
+        std::atomic<size_t> tail{0};
+        Block* block = nullptr;
+        size_t block_index = 0;
+        Block* spare = nullptr;
+    } prod;
+    // Consumer side.
+    struct alignas(deque_cache_line) {
+        std::atomic<size_t> head{0};
+        Block* block = nullptr;
+        size_t block_index = 0;
+        size_t cached_tail = 0;
+    } cons;
+    // Blocks emptied by the consumer, waiting to be picked up by the producer.
+    alignas(deque_cache_line) std::atomic<Block*> returned{nullptr};
+    Allocator alloc;
+
+    Block* allocate_block();
+    void deallocate_chain(Block* block);
+    Block* acquire_block();
+    void release_block(Block* block);
+    T* slot_for_push(size_t tail);
+    T* slot_for_pop(size_t head);
+
+public:
+    SpscDeque(): SpscDeque(Allocator()) {}
+    explicit SpscDeque(const Allocator& al): alloc(al) {
+        prod.block = cons.block = allocate_block();
+    }
+    SpscDeque(const SpscDeque&) = delete;
+    SpscDeque& operator=(const SpscDeque&) = delete;
+    ~SpscDeque();
+
+    // Producer interface.
+    template <typename... Args>
+    void emplace_back(Args&&... args);
+    void push_back(const T& val) {
+        emplace_back(val);
+    }
+    void push_back(T&& val) {
+        emplace_back(std::move(val));
+    }
+    // Pushes n elements and makes them visible to the consumer at once.
+    template <typename InputIt>
+    void push_bulk(InputIt first, size_t n);
+
+    // Consumer interface: pop_front returns false when the queue is empty,
+    // pop_bulk returns how many elements it took. If writing to out throws, the elements
+    // written before stay popped and the rest stay in the queue.
+    bool pop_front(T& out);
+    template <typename OutputIt>
+    size_t pop_bulk(OutputIt out, size_t max);
+
+    // Only a snapshot when the other thread is active. head is read first: tail never
+    // falls behind a head read earlier, so the difference can't wrap around.
+    size_t size() const {
+        size_t head = cons.head.load(std::memory_order_acquire);
+        return prod.tail.load(std::memory_order_acquire) - head;
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+};
+
+template <typename T, typename Allocator, size_t BlockSize>
+SpscDeque<T, Allocator, BlockSize>::~SpscDeque() {
+    size_t head = cons.head.load(std::memory_order_relaxed);
+    size_t tail = prod.tail.load(std::memory_order_relaxed);
+    for (; head != tail; ++head) {
+        AllocTraits::destroy(alloc, slot_for_pop(head));
+    }
+    deallocate_chain(cons.block);
+    deallocate_chain(prod.spare);
+    deallocate_chain(returned.load(std::memory_order_relaxed));
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+typename SpscDeque<T, Allocator, BlockSize>::Block* SpscDeque<T, Allocator, BlockSize>::allocate_block() {
+    BlockAlloc block_alloc(alloc);
+    Block* block = BlockTraits::allocate(block_alloc, 1);
+    BlockTraits::construct(block_alloc, block);
+    return block;
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+void SpscDeque<T, Allocator, BlockSize>::deallocate_chain(Block* block) {
+    BlockAlloc block_alloc(alloc);
+    while (block != nullptr) {
+        Block* next = block->next.load(std::memory_order_relaxed);
+        BlockTraits::destroy(block_alloc, block);
+        BlockTraits::deallocate(block_alloc, block, 1);
+        block = next;
+    }
+}
+
+// Producer: takes a recycled block, grabbing the whole return list when the private one is empty.
+template <typename T, typename Allocator, size_t BlockSize>
+typename SpscDeque<T, Allocator, BlockSize>::Block* SpscDeque<T, Allocator, BlockSize>::acquire_block() {
+    if (prod.spare == nullptr) {
+        prod.spare = returned.exchange(nullptr, std::memory_order_acquire);
+    }
+    if (prod.spare == nullptr) {
+        return allocate_block();
+    }
+    Block* block = prod.spare;
+    prod.spare = block->next.load(std::memory_order_relaxed);
+    block->next.store(nullptr, std::memory_order_relaxed);
+    return block;
+}
+
+// Consumer: hands an emptied block back to the producer.
+template <typename T, typename Allocator, size_t BlockSize>
+void SpscDeque<T, Allocator, BlockSize>::release_block(Block* block) {
+    Block* top = returned.load(std::memory_order_relaxed);
+    do {
+        block->next.store(top, std::memory_order_relaxed);
+    } while (!returned.compare_exchange_weak(top, block, std::memory_order_release, std::memory_order_relaxed));
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+T* SpscDeque<T, Allocator, BlockSize>::slot_for_push(size_t tail) {
+    if (tail / minicap != prod.block_index) {
+        Block* block = acquire_block();
+        prod.block->next.store(block, std::memory_order_release);
+        prod.block = block;
+        ++prod.block_index;
+    }
+    return prod.block->data() + tail % minicap;
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+T* SpscDeque<T, Allocator, BlockSize>::slot_for_pop(size_t head) {
+    if (head / minicap != cons.block_index) {
+        Block* block = cons.block;
+        cons.block = block->next.load(std::memory_order_acquire);
+        release_block(block);
+        ++cons.block_index;
+    }
+    return cons.block->data() + head % minicap;
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+template <typename... Args>
+void SpscDeque<T, Allocator, BlockSize>::emplace_back(Args&&... args) {
+    size_t tail = prod.tail.load(std::memory_order_relaxed);
+    AllocTraits::construct(alloc, slot_for_push(tail), std::forward<Args>(args)...);
+    prod.tail.store(tail + 1, std::memory_order_release);
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+template <typename InputIt>
+void SpscDeque<T, Allocator, BlockSize>::push_bulk(InputIt first, size_t n) {
+    size_t tail = prod.tail.load(std::memory_order_relaxed);
+    size_t i = 0;
+    try {
+        for (; i < n; ++i, ++first) {
+            AllocTraits::construct(alloc, slot_for_push(tail + i), *first);
+        }
+    } catch (...) {
+        prod.tail.store(tail + i, std::memory_order_release);
+        throw;
+    }
+    prod.tail.store(tail + n, std::memory_order_release);
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+bool SpscDeque<T, Allocator, BlockSize>::pop_front(T& out) {
+    return pop_bulk(&out, 1) == 1;
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+template <typename OutputIt>
+size_t SpscDeque<T, Allocator, BlockSize>::pop_bulk(OutputIt out, size_t max) {
+    size_t head = cons.head.load(std::memory_order_relaxed);
+    if (cons.cached_tail - head < max) {
+        cons.cached_tail = prod.tail.load(std::memory_order_acquire);
+    }
+    size_t n = std::min(max, cons.cached_tail - head);
+    size_t i = 0;
+    try {
+        while (i < n) {
+            T* p = slot_for_pop(head + i);
+            *out = std::move(*p);
+            AllocTraits::destroy(alloc, p);
+            ++i;
+            ++out;
+        }
+    } catch (...) {
+        // The elements already moved out and destroyed are gone, the rest stay queued.
+        cons.head.store(head + i, std::memory_order_release);
+        throw;
+    }
+    cons.head.store(head + n, std::memory_order_release);
+    return n;
+}
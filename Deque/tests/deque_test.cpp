@@ -0,0 +1,283 @@
+// Deque and SmallDeque against std::deque: random pushes, pops, range inserts and erases at
+// random positions (which shift the shorter side), copies, moves, reserve and shrink_to_fit,
+// for int and std::string with several block sizes, checked element by element and through
+// the segment algorithms. Then the memory side: blocks are only allocated when used, a FIFO
+// in steady state keeps a bounded number of blocks, and shrink_to_fit gives spares back.
+#include <cassert>
+#include <deque>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "../deque.h"
+#include "../small_deque.h"
+
+int make_value(int i, int) {
+    return i;
+}
+std::string make_value(int i, std::string) {
+    // Long enough to live on the heap, so that lost or doubled moves show up under sanitizers.
+    return std::to_string(i) + std::string(24, 'x');
+}
+
+template <typename D, typename R>
+void check_equal(D& d, const R& r) {
+    assert(d.size() == r.size());
+    for (size_t i = 0; i < r.size(); ++i) {
+        assert(d[i] == r[i]);
+    }
+    auto it = d.begin();
+    for (const auto& x : r) {
+        assert(*it == x);
+        ++it;
+    }
+    assert(it == d.end());
+    assert(static_cast<size_t>(d.end() - d.begin()) == r.size());
+    auto rit = d.rbegin();
+    for (auto i = r.rbegin(); i != r.rend(); ++i, ++rit) {
+        assert(*rit == *i);
+    }
+}
+
+template <typename T, size_t BlockSize>
+void test_random_ops() {
+    using D = Deque<T, std::allocator<T>, BlockSize>;
+    std::mt19937 rng(BlockSize);
+    D d;
+    std::deque<T> r;
+    for (int i = 0; i < 40000; ++i) {
+        T v = make_value(i, T());
+        size_t op = rng() % 12;
+        if (op < 2) {
+            d.push_back(v);
+            r.push_back(v);
+        } else if (op < 4) {
+            d.push_front(v);
+            r.push_front(v);
+        } else if (op == 4 && !r.empty()) {
+            d.pop_back();
+            r.pop_back();
+        } else if (op == 5 && !r.empty()) {
+            d.pop_front();
+            r.pop_front();
+        } else if (op == 6) {
+            // std::deque self-move-assigns on empty ranges, so the reference only gets real ones.
+            size_t pos = rng() % (r.size() + 1);
+            std::vector<T> src;
+            for (size_t k = 1 + rng() % (2 * BlockSize); k > 0; --k) {
+                src.push_back(make_value(-i, T()));
+            }
+            auto it = d.insert(d.begin() + pos, src.begin(), src.end());
+            r.insert(r.begin() + pos, src.begin(), src.end());
+            assert(static_cast<size_t>(it - d.begin()) == pos);
+        } else if (op == 7 && !r.empty()) {
+            size_t first = rng() % r.size();
+            size_t last = first + 1 + rng() % std::min<size_t>(r.size() - first, 2 * BlockSize);
+            auto it = d.erase(d.begin() + first, d.begin() + last);
+            r.erase(r.begin() + first, r.begin() + last);
+            assert(static_cast<size_t>(it - d.begin()) == first);
+        } else if (op == 8 && !r.empty()) {
+            size_t pos = rng() % r.size();
+            d.insert(d.begin() + pos, v);
+            r.insert(r.begin() + pos, v);
+            pos = rng() % r.size();
+            d.erase(d.begin() + pos);
+            r.erase(r.begin() + pos);
+        } else if (op == 9 && !r.empty()) {
+            size_t pos = rng() % r.size();
+            d[pos] = v;
+            r[pos] = v;
+            assert(d.at(pos) == v);
+        } else if (op == 10 && rng() % 50 == 0) {
+            d.reserve(r.size() + rng() % 1000);
+            check_equal(d, r);
+            d.shrink_to_fit();
+        } else if (op == 11 && rng() % 100 == 0) {
+            D copy(d);
+            check_equal(copy, r);
+            D moved(std::move(copy));
+            d = moved;
+            check_equal(d, r);
+            d = std::move(moved);
+        }
+        if (r.size() > 3000) {
+            // Drain to a few elements so that both ends empty whole blocks.
+            while (r.size() > 10) {
+                if (rng() % 2) {
+                    d.pop_front();
+                    r.pop_front();
+                } else {
+                    d.pop_back();
+                    r.pop_back();
+                }
+            }
+        }
+        if (i % 257 == 0) {
+            check_equal(d, r);
+        }
+    }
+    check_equal(d, r);
+    bool thrown = false;
+    try {
+        d.at(r.size());
+    } catch (const std::out_of_range&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+// The hidden-friend algorithms walk the deque segment by segment.
+template <size_t BlockSize>
+void test_segment_algorithms() {
+    Deque<int, std::allocator<int>, BlockSize> d;
+    for (int i = 0; i < 1000; ++i) {
+        d.push_back(i);
+        d.push_front(-i - 1);
+    }
+    long sum = 0;
+    for_each(d, [&sum](int x) {
+        sum += x;
+    });
+    assert(sum == -1000);
+    assert(accumulate(d, 0L) == -1000);
+    std::vector<int> out;
+    copy(d, std::back_inserter(out));
+    assert(out.size() == 2000);
+    for (size_t i = 0; i < out.size(); ++i) {
+        assert(out[i] == static_cast<int>(i) - 1000);
+    }
+    auto it = find(d, 7);
+    assert(it - d.begin() == 1007);
+    assert(find(d, 5000) == d.end());
+    size_t spans = 0;
+    size_t total = 0;
+    for (auto seg : d.segments()) {
+        assert(!seg.empty() && seg.size() <= BlockSize);
+        ++spans;
+        total += seg.size();
+    }
+    assert(total == 2000 && spans >= 2000 / BlockSize);
+    fill(d, 3);
+    assert(accumulate(d, 0L) == 6000);
+}
+
+void test_memory() {
+    // An empty deque owns nothing, reserve only makes the map bigger.
+    Deque<int, std::allocator<int>, 16> d;
+    assert(d.memory_usage().total_bytes() == 0);
+    d.reserve(10000);
+    auto reserved = d.memory_usage();
+    assert(reserved.map_bytes >= 10000 / 16 * sizeof(int*));
+    assert(reserved.live_blocks <= 1);
+    size_t map_bytes = reserved.map_bytes;
+    for (int i = 0; i < 10000; ++i) {
+        d.push_back(i);
+    }
+    assert(d.memory_usage().map_bytes == map_bytes);
+
+    // A FIFO in steady state recycles its blocks and keeps the map from growing.
+    Deque<int, std::allocator<int>, 16> q;
+    for (int i = 0; i < 100; ++i) {
+        q.push_back(i);
+    }
+    auto before = q.memory_usage();
+    for (int i = 100; i < 1000000; ++i) {
+        q.push_back(i);
+        q.pop_front();
+        auto usage = q.memory_usage();
+        assert(usage.live_blocks <= 100 / 16 + 2);
+        assert(usage.spare_blocks <= 2);
+        assert(usage.map_bytes <= 2 * before.map_bytes);
+    }
+    assert(q[0] == 999900);
+
+    // Popping leaves spare blocks behind, shrink_to_fit returns them and trims the map.
+    while (d.size() > 16) {
+        d.pop_back();
+    }
+    d.shrink_to_fit();
+    auto trimmed = d.memory_usage();
+    assert(trimmed.spare_blocks == 0 && trimmed.live_blocks <= 2);
+    assert(trimmed.map_bytes < map_bytes);
+    d.pop_back();
+    while (d.size() > 0) {
+        d.pop_front();
+    }
+    d.shrink_to_fit();
+    assert(d.memory_usage().total_bytes() == 0);
+}
+
+void test_growth_factor() {
+    Deque<int> d;
+    d.set_growth_factor(1.5);
+    Deque<int> copy(d);
+    assert(copy.growth_factor() == 1.5);
+    bool thrown = false;
+    try {
+        d.set_growth_factor(1.0);
+    } catch (const std::invalid_argument&) {
+        thrown = true;
+    }
+    assert(thrown && d.growth_factor() == 1.5);
+}
+
+template <typename T>
+void test_small_deque() {
+    std::mt19937 rng(7);
+    SmallDeque<T, 8, std::allocator<T>, 4> d;
+    std::deque<T> r;
+    for (int i = 0; i < 20000; ++i) {
+        T v = make_value(i, T());
+        size_t op = rng() % 6;
+        if (op == 0) {
+            d.push_back(v);
+            r.push_back(v);
+        } else if (op == 1) {
+            d.push_front(v);
+            r.push_front(v);
+        } else if (op == 2 && !r.empty()) {
+            d.pop_back();
+            r.pop_back();
+        } else if (op == 3 && !r.empty()) {
+            d.pop_front();
+            r.pop_front();
+        } else if (op == 4 && !r.empty()) {
+            // Pushing an element of the deque itself, also when that spills the ring.
+            T& x = d[rng() % r.size()];
+            r.push_back(x);
+            d.push_back(x);
+        } else if (op == 5 && rng() % 20 == 0) {
+            d.shrink_to_fit();
+            assert(d.is_inline() == (r.size() <= 8));
+            auto copy = d;
+            check_equal(copy, r);
+            auto moved = std::move(copy);
+            d = moved;
+        }
+        if (r.size() > 40) {
+            while (r.size() > 3) {
+                d.pop_front();
+                r.pop_front();
+            }
+        }
+        if (i % 61 == 0) {
+            check_equal(d, r);
+        }
+    }
+    check_equal(d, r);
+}
+
+int main() {
+    test_random_ops<int, 4>();
+    test_random_ops<int, 8>();
+    test_random_ops<int, 128>();
+    test_random_ops<std::string, 4>();
+    test_random_ops<std::string, 8>();
+    test_random_ops<std::string, 128>();
+    test_segment_algorithms<4>();
+    test_segment_algorithms<128>();
+    test_memory();
+    test_growth_factor();
+    test_small_deque<int>();
+    test_small_deque<std::string>();
+}
@@ -0,0 +1,122 @@
+// MappedDeque in a temporary file: pushes and pops at both ends across several doublings
+// of the ring, then closes and reopens the file and compares it with a std::deque, over
+// several cycles. Files with a wrong magic, written for another element or block size, or
+// cut short are rejected when opened.
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include "../mapped_deque.h"
+
+using Queue = MappedDeque<uint64_t, 16>;
+using OtherElement = MappedDeque<uint32_t, 16>;
+using OtherBlockSize = MappedDeque<uint64_t, 32>;
+
+std::string temp_path(const char* name) {
+    auto path = std::filesystem::temp_directory_path() / (name + std::to_string(::getpid()));
+    std::filesystem::remove(path);
+    return path.string();
+}
+
+template <typename Q>
+void check_equal(const Q& q, const std::deque<uint64_t>& r) {
+    assert(q.size() == r.size());
+    for (size_t i = 0; i < r.size(); ++i) {
+        assert(q[i] == r[i]);
+    }
+}
+
+void test_reopen() {
+    std::string path = temp_path("mapped_deque_reopen");
+    std::mt19937 rng(5);
+    std::deque<uint64_t> r;
+    uint64_t next = 0;
+    for (int cycle = 0; cycle < 6; ++cycle) {
+        Queue q(path, 1);
+        check_equal(q, r);
+        // Mostly pushes, so that every cycle doubles the ring a few more times.
+        for (int i = 0; i < 3000; ++i) {
+            size_t op = rng() % 8;
+            if (op < 3) {
+                q.push_back(next);
+                r.push_back(next++);
+            } else if (op < 6) {
+                q.push_front(next);
+                r.push_front(next++);
+            } else if (op == 6 && !r.empty()) {
+                q.pop_back();
+                r.pop_back();
+            } else if (op == 7 && !r.empty()) {
+                q.pop_front();
+                r.pop_front();
+            }
+        }
+        check_equal(q, r);
+        if (cycle % 2 == 0) {
+            q.flush();
+        }
+        bool thrown = false;
+        try {
+            q.at(r.size());
+        } catch (const std::out_of_range&) {
+            thrown = true;
+        }
+        assert(thrown);
+    }
+    Queue q(path);
+    check_equal(q, r);
+    std::filesystem::remove(path);
+}
+
+template <typename Q>
+bool rejected(const std::string& path) {
+    try {
+        Q q(path);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+void test_rejects() {
+    std::string path = temp_path("mapped_deque_rejects");
+    {
+        Queue q(path, 4);
+        for (uint64_t i = 0; i < 200; ++i) {
+            q.push_back(i);
+        }
+    }
+    assert(!rejected<Queue>(path));
+    assert(rejected<OtherElement>(path));
+    assert(rejected<OtherBlockSize>(path));
+
+    // Cutting the ring short, and cutting into the header.
+    auto bytes = std::filesystem::file_size(path);
+    std::filesystem::resize_file(path, bytes - 8);
+    assert(rejected<Queue>(path));
+    std::filesystem::resize_file(path, 100);
+    assert(rejected<Queue>(path));
+
+    std::filesystem::remove(path);
+    {
+        Queue q(path);
+        q.push_back(1);
+    }
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(0);
+        f.write("NOTAQUEUE", 8);
+    }
+    assert(rejected<Queue>(path));
+    std::filesystem::remove(path);
+}
+
+int main() {
+    test_reopen();
+    test_rejects();
+}
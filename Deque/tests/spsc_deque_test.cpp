@@ -0,0 +1,143 @@
+// A producer and a consumer thread pass a numbered sequence through SpscDeque, mixing
+// single and bulk operations; the consumer checks that nothing is lost, duplicated or
+// reordered, and size() is sampled from both sides while the queue is in use. A bulk pop
+// into an output that throws keeps every element popped or queued exactly once.
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../spsc_deque.h"
+
+constexpr size_t items = 1 << 20;
+
+void test_sequence() {
+    SpscDeque<size_t, std::allocator<size_t>, 64> q;
+    std::thread producer([&q] {
+        size_t next = 0;
+        std::vector<size_t> batch;
+        while (next < items) {
+            if (next % 3 == 0) {
+                q.push_back(next++);
+            } else {
+                batch.clear();
+                for (size_t k = 0; k < 37 && next < items; ++k) {
+                    batch.push_back(next++);
+                }
+                q.push_bulk(batch.begin(), batch.size());
+            }
+            assert(q.size() <= items);
+        }
+    });
+    size_t expected = 0;
+    size_t buf[50];
+    while (expected < items) {
+        assert(q.size() <= items);
+        size_t n;
+        if (expected % 2 == 0) {
+            n = q.pop_front(buf[0]) ? 1 : 0;
+        } else {
+            n = q.pop_bulk(buf, 50);
+        }
+        for (size_t k = 0; k < n; ++k) {
+            assert(buf[k] == expected);
+            ++expected;
+        }
+    }
+    producer.join();
+    assert(q.empty());
+}
+
+// Elements left in the queue are destroyed with it.
+void test_destroy() {
+    SpscDeque<std::string, std::allocator<std::string>, 4> q;
+    for (int i = 0; i < 100; ++i) {
+        q.push_back(std::string(40, 'a' + i % 26));
+    }
+    std::string s;
+    for (int i = 0; i < 30; ++i) {
+        assert(q.pop_front(s));
+        assert(s == std::string(40, 'a' + i % 26));
+    }
+    assert(q.size() == 70);
+}
+
+// Counts live objects, so an element destroyed twice or never shows up in live.
+struct Counted {
+    static int live;
+    int value = 0;
+
+    Counted(int v): value(v) {
+        ++live;
+    }
+    Counted(const Counted& other): value(other.value) {
+        ++live;
+    }
+    Counted& operator=(Counted&& other) = default;
+    ~Counted() {
+        --live;
+    }
+};
+int Counted::live = 0;
+
+// Output iterator whose assignment throws once `left` elements have been written.
+struct ThrowingOutput {
+    std::vector<int>* written;
+    size_t left;
+
+    ThrowingOutput& operator*() {
+        return *this;
+    }
+    ThrowingOutput& operator++() {
+        return *this;
+    }
+    ThrowingOutput& operator=(Counted&& c) {
+        if (left == 0) {
+            throw std::runtime_error("output full");
+        }
+        --left;
+        written->push_back(c.value);
+        return *this;
+    }
+};
+
+void test_throwing_output() {
+    {
+        SpscDeque<Counted, std::allocator<Counted>, 4> q;
+        for (int i = 0; i < 50; ++i) {
+            q.push_back(Counted(i));
+        }
+        std::vector<int> written;
+        int next = 0;
+        // Writes that stop inside a block and right at a block boundary.
+        for (size_t limit : {3, 5, 4, 11}) {
+            bool thrown = false;
+            try {
+                q.pop_bulk(ThrowingOutput{&written, limit}, 20);
+            } catch (const std::runtime_error&) {
+                thrown = true;
+            }
+            assert(thrown);
+            assert(written.size() == limit);
+            for (int v : written) {
+                assert(v == next++);
+            }
+            written.clear();
+            assert(q.size() == 50u - next);
+            assert(Counted::live == 50 - next);
+        }
+        assert(q.pop_bulk(ThrowingOutput{&written, 100}, 100) == 50u - next);
+        for (int v : written) {
+            assert(v == next++);
+        }
+        assert(next == 50 && q.empty() && Counted::live == 0);
+        q.push_back(Counted(7));
+    }
+    assert(Counted::live == 0);
+}
+
+int main() {
+    test_sequence();
+    test_destroy();
+    test_throwing_output();
+}
@@ -0,0 +1,65 @@
+// The owner pushes a numbered sequence and pops some of it back while thieves steal from
+// the front; every item has to be taken exactly once. The deque starts with a one-block
+// map, so it grows (and retires maps) while thieves are reading it.
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <vector>
+#include "../work_stealing_deque.h"
+
+void test_single_thread() {
+    WorkStealingDeque<int, std::allocator<int>, 4> d;
+    assert(!d.pop_back() && !d.pop_front());
+    for (int i = 0; i < 100; ++i) {
+        d.push_back(i);
+    }
+    assert(*d.pop_front() == 0);
+    assert(*d.pop_back() == 99);
+    assert(d.size() == 98);
+}
+
+void test_owner_and_thieves(int thieves) {
+    const int items = 200000;
+    WorkStealingDeque<int, std::allocator<int>, 8> d(std::allocator<int>(), 1);
+    std::vector<std::atomic<int>> taken(items);
+    std::atomic<int> count{0};
+    std::atomic<bool> done{false};
+    auto take = [&](std::optional<int> v) {
+        if (v) {
+            taken[*v].fetch_add(1, std::memory_order_relaxed);
+            count.fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int k = 0; k < thieves; ++k) {
+        threads.emplace_back([&] {
+            while (!done.load(std::memory_order_relaxed)) {
+                take(d.pop_front());
+            }
+        });
+    }
+    for (int i = 0; i < items; ++i) {
+        d.push_back(i);
+        if (i % 3 == 0) {
+            take(d.pop_back());
+        }
+    }
+    while (count.load() < items) {
+        take(d.pop_back());
+    }
+    done = true;
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    for (int i = 0; i < items; ++i) {
+        assert(taken[i].load() == 1);
+    }
+    assert(d.empty());
+}
+
+int main() {
+    test_single_thread();
+    for (int thieves = 1; thieves <= 3; ++thieves) {
+        test_owner_and_thieves(thieves);
+    }
+}
@@ -0,0 +1,261 @@
+#pragma once
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include "deque.h"
+
+// Chase-Lev work-stealing deque on top of Deque-style blocks. The owner thread calls
+// push_back/pop_back, any other thread may call pop_front to steal the oldest element.
+//
+// Elements are addressed by 64-bit counters: the element i lives in block i / BlockSize,
+// and block b sits in map slot b % map size, so the map works as a ring of blocks. When
+// the owner runs out of slots it builds a map twice as large that refers to the same
+// blocks; blocks themselves are only freed by the destructor. Thieves may still be
+// reading the old map, so it is retired and freed once the epoch has moved two steps
+// past the retirement (see enter/leave and try_reclaim).
+//
+// Thieves read slots speculatively before they claim them, so the slots are atomics
+// and T has to be trivially copyable (a task pointer or handle, typically).
+template <typename T, typename Allocator = std::allocator<T>, size_t BlockSize = deque_block_size<T>()>
+class WorkStealingDeque {
+    static_assert(BlockSize > 0, "WorkStealingDeque block size must be positive");
+    static_assert(std::is_trivially_copyable_v<T>, "WorkStealingDeque requires a trivially copyable T");
+private:
+    constexpr static size_t minicap = BlockSize;
+    struct alignas(deque_cache_line) Block {
+        std::atomic<T> slots[minicap];
+    };
+    struct Map {
+        size_t size;
+        std::atomic<Block*>* slots;
+        Map* retired_next = nullptr;
+        uint64_t retired_epoch = 0;
+    };
+
+public:
+    using AllocTraits = std::allocator_traits<Allocator>;
+    using BlockAlloc = typename AllocTraits::template rebind_alloc<Block>;
+    using BlockTraits = std::allocator_traits<BlockAlloc>;
+    using MapAlloc = typename AllocTraits::template rebind_alloc<Map>;
+    using MapTraits = std::allocator_traits<MapAlloc>;
+    using SlotAlloc = typename AllocTraits::template rebind_alloc<std::atomic<Block*>>;
+    using SlotTraits = std::allocator_traits<SlotAlloc>;
+
+private:
+    alignas(deque_cache_line) std::atomic<int64_t> top{0};
+    alignas(deque_cache_line) std::atomic<int64_t> bottom{0};
+    alignas(deque_cache_line) std::atomic<Map*> map{nullptr};
+    // Thieves announce themselves in the counter of the current epoch's parity.
+    alignas(deque_cache_line) std::atomic<uint64_t> epoch{2};
+    std::atomic<size_t> readers[2] = {};
+    // Owner-only state.
+    Map* retired = nullptr;
+    Allocator alloc;
+
+    Map* allocate_map(size_t n);
+    void deallocate_map(Map* m);
+    Block* block_for(Map* m, int64_t index);
+    Map* grow(Map* m, int64_t t);
+    void try_reclaim();
+    uint64_t enter();
+    void leave(uint64_t e);
+
+public:
+    WorkStealingDeque(): WorkStealingDeque(Allocator()) {}
+    explicit WorkStealingDeque(const Allocator& al, size_t blocks = 4): alloc(al) {
+        map.store(allocate_map(blocks < 1 ? 1 : blocks), std::memory_order_relaxed);
+    }
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+    ~WorkStealingDeque();
+
+    // Owner interface.
+    void push_back(const T& val);
+    std::optional<T> pop_back();
+
+    // Thief interface. Returns nothing when the deque is empty or another thread won the race.
+    std::optional<T> pop_front();
+
+    // Only a snapshot when other threads are active.
+    size_t size() const {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        int64_t t = top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+};
+
+template <typename T, typename Allocator, size_t BlockSize>
+WorkStealingDeque<T, Allocator, BlockSize>::~WorkStealingDeque() {
+    Map* m = map.load(std::memory_order_relaxed);
+    BlockAlloc block_alloc(alloc);
+    for (size_t i = 0; i < m->size; ++i) {
+        Block* block = m->slots[i].load(std::memory_order_relaxed);
+        if (block != nullptr) {
+            BlockTraits::destroy(block_alloc, block);
+            BlockTraits::deallocate(block_alloc, block, 1);
+        }
+    }
+    deallocate_map(m);
+    while (retired != nullptr) {
+        Map* next = retired->retired_next;
+        deallocate_map(retired);
+        retired = next;
+    }
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+typename WorkStealingDeque<T, Allocator, BlockSize>::Map* WorkStealingDeque<T, Allocator, BlockSize>::allocate_map(size_t n) {
+    MapAlloc map_alloc(alloc);
+    SlotAlloc slot_alloc(alloc);
+    Map* m = MapTraits::allocate(map_alloc, 1);
+    try {
+        std::atomic<Block*>* slots = SlotTraits::allocate(slot_alloc, n);
+        for (size_t i = 0; i < n; ++i) {
+            SlotTraits::construct(slot_alloc, slots + i, nullptr);
+        }
+        MapTraits::construct(map_alloc, m, Map{n, slots});
+    } catch (...) {
+        MapTraits::deallocate(map_alloc, m, 1);
+        throw;
+    }
+    return m;
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+void WorkStealingDeque<T, Allocator, BlockSize>::deallocate_map(Map* m) {
+    MapAlloc map_alloc(alloc);
+    SlotAlloc slot_alloc(alloc);
+    SlotTraits::deallocate(slot_alloc, m->slots, m->size);
+    MapTraits::destroy(map_alloc, m);
+    MapTraits::deallocate(map_alloc, m, 1);
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+typename WorkStealingDeque<T, Allocator, BlockSize>::Block*
+WorkStealingDeque<T, Allocator, BlockSize>::block_for(Map* m, int64_t index) {
+    return m->slots[static_cast<uint64_t>(index) / minicap % m->size].load(std::memory_order_acquire);
+}
+
+// Owner: doubles the map. Every old slot moves to the new position of the block
+// number it currently holds, starting from the block of top.
+template <typename T, typename Allocator, size_t BlockSize>
+typename WorkStealingDeque<T, Allocator, BlockSize>::Map*
+WorkStealingDeque<T, Allocator, BlockSize>::grow(Map* m, int64_t t) {
+    Map* nm = allocate_map(m->size * 2);
+    uint64_t first = static_cast<uint64_t>(t) / minicap;
+    for (uint64_t k = first; k < first + m->size; ++k) {
+        nm->slots[k % nm->size].store(m->slots[k % m->size].load(std::memory_order_relaxed),
+                                      std::memory_order_release);
+    }
+    map.store(nm, std::memory_order_release);
+    m->retired_epoch = epoch.load(std::memory_order_seq_cst);
+    m->retired_next = retired;
+    retired = m;
+    try_reclaim();
+    return nm;
+}
+
+// Owner: moves the epoch forward when no thief of the epoch before the current one is
+// left, then frees the maps retired at least two epochs ago.
+template <typename T, typename Allocator, size_t BlockSize>
+void WorkStealingDeque<T, Allocator, BlockSize>::try_reclaim() {
+    uint64_t e = epoch.load(std::memory_order_seq_cst);
+    if (readers[(e + 1) & 1].load(std::memory_order_seq_cst) == 0) {
+        epoch.store(++e, std::memory_order_seq_cst);
+    }
+    Map** p = &retired;
+    while (*p != nullptr) {
+        if ((*p)->retired_epoch + 2 <= e) {
+            Map* m = *p;
+            *p = m->retired_next;
+            deallocate_map(m);
+        } else {
+            p = &(*p)->retired_next;
+        }
+    }
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+uint64_t WorkStealingDeque<T, Allocator, BlockSize>::enter() {
+    while (true) {
+        uint64_t e = epoch.load(std::memory_order_seq_cst);
+        readers[e & 1].fetch_add(1, std::memory_order_seq_cst);
+        if (epoch.load(std::memory_order_seq_cst) == e) {
+            return e;
+        }
+        readers[e & 1].fetch_sub(1, std::memory_order_seq_cst);
+    }
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+void WorkStealingDeque<T, Allocator, BlockSize>::leave(uint64_t e) {
+    readers[e & 1].fetch_sub(1, std::memory_order_seq_cst);
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+void WorkStealingDeque<T, Allocator, BlockSize>::push_back(const T& val) {
+    int64_t b = bottom.load(std::memory_order_relaxed);
+    int64_t t = top.load(std::memory_order_acquire);
+    Map* m = map.load(std::memory_order_relaxed);
+    if (static_cast<uint64_t>(b) / minicap - static_cast<uint64_t>(t) / minicap >= m->size) {
+        m = grow(m, t);
+    }
+    std::atomic<Block*>& slot = m->slots[static_cast<uint64_t>(b) / minicap % m->size];
+    Block* block = slot.load(std::memory_order_relaxed);
+    if (block == nullptr) {
+        BlockAlloc block_alloc(alloc);
+        block = BlockTraits::allocate(block_alloc, 1);
+        BlockTraits::construct(block_alloc, block);
+        slot.store(block, std::memory_order_release);
+    }
+    block->slots[static_cast<uint64_t>(b) % minicap].store(val, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+std::optional<T> WorkStealingDeque<T, Allocator, BlockSize>::pop_back() {
+    int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+    Map* m = map.load(std::memory_order_relaxed);
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top.load(std::memory_order_relaxed);
+    if (t > b) {
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return std::nullopt;
+    }
+    std::optional<T> val = block_for(m, b)->slots[static_cast<uint64_t>(b) % minicap].load(std::memory_order_relaxed);
+    if (t == b) {
+        // The last element: race the thieves for it.
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            val.reset();
+        }
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return val;
+}
+
+template <typename T, typename Allocator, size_t BlockSize>
+std::optional<T> WorkStealingDeque<T, Allocator, BlockSize>::pop_front() {
+    uint64_t e = enter();
+    int64_t t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom.load(std::memory_order_acquire);
+    std::optional<T> val;
+    if (t < b) {
+        // A missing block means t went stale before the last growth: the CAS would fail anyway.
+        Block* block = block_for(map.load(std::memory_order_acquire), t);
+        if (block != nullptr) {
+            T x = block->slots[static_cast<uint64_t>(t) % minicap].load(std::memory_order_relaxed);
+            if (top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                val = x;
+            }
+        }
+    }
+    leave(e);
+    return val;
+}
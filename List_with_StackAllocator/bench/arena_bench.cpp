@@ -0,0 +1,79 @@
+// Lists built in parallel: every thread builds and destroys Lists of 100K ints with
+// push_back, with std::allocator, a synchronized pool resource, one ConcurrentArena shared
+// by all threads and a ThreadArena per thread, for 1 to max(4, hardware threads) threads.
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <memory_resource>
+#include <thread>
+#include <vector>
+#include "bench.h"
+#include "../concurrent_arena.h"
+
+constexpr size_t elements = 100000;
+constexpr size_t rounds = 4;
+// Enough for every node built in one run with the largest thread count.
+constexpr size_t node_bytes = 64;
+
+using PmrList = List<int, std::pmr::polymorphic_allocator<int>>;
+
+// Elements built by all threads, so that the lists are not optimized away.
+std::atomic<size_t> built{0};
+
+template <typename F>
+void on_threads(size_t threads, F f) {
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back(f);
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+template <typename L, typename... Args>
+void build(Args&&... args) {
+    for (size_t r = 0; r < rounds; ++r) {
+        L lst(args...);
+        for (size_t i = 0; i < elements; ++i) {
+            lst.push_back(static_cast<int>(i));
+        }
+        built.fetch_add(lst.size(), std::memory_order_relaxed);
+    }
+}
+
+int main() {
+    size_t max_threads = std::max<size_t>(4, std::thread::hardware_concurrency());
+    auto buffer = std::make_unique<uint8_t[]>(max_threads * rounds * elements * node_bytes);
+
+    std::printf("%zu rounds of building a List of %zu ints per thread, best of 3, ms\n", rounds, elements);
+    std::printf("%8s %14s %14s %14s %14s\n", "threads", "std::allocator", "sync pool", "shared arena", "ThreadArena");
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        double plain = bench_ms([threads] {
+            on_threads(threads, [] {
+                build<List<int>>();
+            });
+        }, 3);
+        double pool = bench_ms([threads] {
+            std::pmr::synchronized_pool_resource resource;
+            on_threads(threads, [&resource] {
+                build<PmrList>(&resource);
+            });
+        }, 3);
+        double shared = bench_ms([threads, &buffer, max_threads] {
+            ConcurrentArena arena(buffer.get(), max_threads * rounds * elements * node_bytes);
+            on_threads(threads, [&arena] {
+                build<PmrList>(&arena);
+            });
+        }, 3);
+        double local = bench_ms([threads, &buffer, max_threads] {
+            ConcurrentArena arena(buffer.get(), max_threads * rounds * elements * node_bytes);
+            on_threads(threads, [&arena] {
+                ThreadArena own(arena);
+                build<PmrList>(&own);
+            });
+        }, 3);
+        std::printf("%8zu %14.2f %14.2f %14.2f %14.2f\n", threads, plain, pool, shared, local);
+    }
+    bench_sink = built.load();
+}
@@ -0,0 +1,53 @@
+// Insert/erase churn on a List of 10K ints with std::allocator, PoolAllocator and
+// StackAllocator: every step erases a random element and appends a new one, so nodes
+// are freed in random order. Also reports how much arena memory each arena needed.
+#include <memory>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "../list.h"
+
+constexpr size_t live = 10000;
+constexpr size_t steps = 2000000;
+constexpr size_t arena_bytes = 1 << 20;
+
+template <typename L>
+double churn(L& lst) {
+    std::vector<typename L::iterator> nodes;
+    std::mt19937 rng(1);
+    for (size_t i = 0; i < live; ++i) {
+        lst.push_back(static_cast<int>(i));
+        nodes.push_back(std::prev(lst.end()));
+    }
+    return bench_ms([&lst, &nodes, &rng] {
+        for (size_t i = 0; i < steps; ++i) {
+            size_t j = rng() % live;
+            int v = *nodes[j];
+            lst.erase(nodes[j]);
+            lst.push_back(v + 1);
+            nodes[j] = std::prev(lst.end());
+        }
+        bench_sink = bench_sink + static_cast<size_t>(*std::prev(lst.end()));
+    }, 3);
+}
+
+int main() {
+    std::printf("%zu live ints, %zu erase + push_back steps, best of 3\n", live, steps);
+    std::printf("%16s %10s %14s %10s\n", "allocator", "ms", "arena bytes", "overflows");
+
+    List<int> plain;
+    std::printf("%16s %10.2f %14s %10s\n", "std::allocator", churn(plain), "-", "-");
+
+    auto pool_storage = std::make_unique<StackStorage<arena_bytes>>();
+    List<int, PoolAllocator<int, arena_bytes>> pooled{PoolAllocator<int, arena_bytes>(*pool_storage)};
+    double pool_ms = churn(pooled);
+    const auto& pool_stats = pool_storage->get_stats();
+    std::printf("%16s %10.2f %14zu %10zu\n", "PoolAllocator", pool_ms, pool_stats.high_water, pool_stats.overflow_count);
+
+    // Freed nodes are only reclaimed when they are the latest allocation, so the arena keeps growing.
+    auto stack_storage = std::make_unique<StackStorage<arena_bytes>>();
+    List<int, StackAllocator<int, arena_bytes>> stacked{StackAllocator<int, arena_bytes>(*stack_storage)};
+    double stack_ms = churn(stacked);
+    const auto& stack_stats = stack_storage->get_stats();
+    std::printf("%16s %10.2f %14zu %10zu\n", "StackAllocator", stack_ms, stack_stats.high_water, stack_stats.overflow_count);
+}
@@ -0,0 +1,70 @@
+// UnrolledList against List on ints: a full traversal, and inserts and erases at random
+// positions, each of which walks to its position from the front.
+#include <iterator>
+#include <random>
+#include "bench.h"
+#include "../list.h"
+#include "../unrolled_list.h"
+
+constexpr size_t traversal_size = 1 << 20;
+constexpr size_t random_size = 20000;
+constexpr size_t random_ops = 5000;
+
+template <typename L>
+double traverse() {
+    L lst;
+    for (size_t i = 0; i < traversal_size; ++i) {
+        lst.push_back(static_cast<int>(i));
+    }
+    return bench_ms([&lst] {
+        size_t sum = 0;
+        for (int x : lst) {
+            sum += static_cast<size_t>(x);
+        }
+        bench_sink = sum;
+    });
+}
+
+template <typename L>
+double random_insert() {
+    return bench_ms([] {
+        L lst;
+        for (size_t i = 0; i < random_size; ++i) {
+            lst.push_back(static_cast<int>(i));
+        }
+        std::mt19937 rng(1);
+        for (size_t i = 0; i < random_ops; ++i) {
+            lst.insert(std::next(lst.begin(), rng() % (lst.size() + 1)), static_cast<int>(i));
+        }
+        bench_sink = lst.size();
+    }, 3);
+}
+
+template <typename L>
+double random_erase() {
+    return bench_ms([] {
+        L lst;
+        for (size_t i = 0; i < random_size; ++i) {
+            lst.push_back(static_cast<int>(i));
+        }
+        std::mt19937 rng(1);
+        for (size_t i = 0; i < random_ops; ++i) {
+            lst.erase(std::next(lst.begin(), rng() % lst.size()));
+        }
+        bench_sink = lst.size();
+    }, 3);
+}
+
+template <typename L>
+void row(const char* name) {
+    std::printf("%20s %12.2f %14.2f %14.2f\n", name, traverse<L>(), random_insert<L>(), random_erase<L>());
+}
+
+int main() {
+    std::printf("traversal of %zu ints; %zu inserts / erases in a list of %zu ints; ms\n",
+                traversal_size, random_ops, random_size);
+    std::printf("%20s %12s %14s %14s\n", "container", "traversal", "random insert", "random erase");
+    row<List<int>>("List");
+    row<UnrolledList<int, 16>>("UnrolledList<16>");
+    row<UnrolledList<int, 64>>("UnrolledList<64>");
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory_resource>
+#include <thread>
+#include "list.h"
+
+// Monotonic arena that any number of threads can allocate from without a lock: the bump
+// pointer is an atomic offset advanced with fetch_add. Sizes are rounded up to
+// pool_granularity so that every offset stays aligned without a compare-and-swap loop.
+// Once the buffer is used up, every allocation gets its own buffer from the upstream
+// resource, which then has to be thread-safe itself (the default resource is).
+// Memory is only given back by the destructor.
+//
+// Threads that allocate a lot should rather carve a ThreadArena each out of one shared
+// ConcurrentArena: bumping the shared offset is cheap, but it is still one contended
+// cache line.
+class ConcurrentArena: public std::pmr::memory_resource {
+private:
+    struct Chunk {
+        Chunk* prev;
+        size_t bytes;
+        size_t align;
+    };
+
+    uint8_t* memory;
+    size_t memory_size;
+    std::atomic<size_t> offset{0};
+    // Upstream buffers, pushed by whichever thread overflowed.
+    std::atomic<Chunk*> chunks{nullptr};
+    std::atomic<size_t> overflows{0};
+    std::pmr::memory_resource* upstream;
+
+    static size_t round_up(size_t n, size_t align) {
+        return (n + align - 1) / align * align;
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t align) override {
+        size_t padding = align > pool_granularity ? align - pool_granularity : 0;
+        size_t sz = round_up(bytes + padding, pool_granularity);
+        size_t start = offset.fetch_add(sz, std::memory_order_relaxed);
+        if (start <= memory_size && sz <= memory_size - start) {
+            auto h = reinterpret_cast<uintptr_t>(memory + start);
+            return memory + start + (align - h % align) % align;
+        }
+        return overflow(bytes, align);
+    }
+    void do_deallocate(void*, size_t, size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    void* overflow(size_t bytes, size_t align) {
+        align = std::max(align, pool_granularity);
+        size_t header = round_up(sizeof(Chunk), align);
+        size_t sz = header + bytes;
+        void* raw = upstream->allocate(sz, align);
+        auto chunk = new(raw) Chunk{chunks.load(std::memory_order_relaxed), sz, align};
+        while (!chunks.compare_exchange_weak(chunk->prev, chunk, std::memory_order_release, std::memory_order_relaxed)) {}
+        overflows.fetch_add(1, std::memory_order_relaxed);
+        return static_cast<uint8_t*>(raw) + header;
+    }
+
+public:
+    ConcurrentArena(uint8_t* buffer, size_t n, std::pmr::memory_resource* upstream = std::pmr::get_default_resource()):
+            upstream(upstream) {
+        // Align the start so that rounded offsets are aligned addresses.
+        auto h = reinterpret_cast<uintptr_t>(buffer);
+        size_t shift = std::min(n, (pool_granularity - h % pool_granularity) % pool_granularity);
+        memory = buffer + shift;
+        memory_size = n - shift;
+    }
+    ~ConcurrentArena() {
+        Chunk* chunk = chunks.load(std::memory_order_acquire);
+        while (chunk != nullptr) {
+            Chunk* prev = chunk->prev;
+            upstream->deallocate(chunk, chunk->bytes, chunk->align);
+            chunk = prev;
+        }
+    }
+    ConcurrentArena(ConcurrentArena const&) = delete;
+    void operator=(ConcurrentArena const&) = delete;
+
+    // Bytes taken from the buffer so far, rounding included.
+    size_t used() const {
+        return std::min(offset.load(std::memory_order_relaxed), memory_size);
+    }
+    size_t capacity() const {
+        return memory_size;
+    }
+    size_t overflow_count() const {
+        return overflows.load(std::memory_order_relaxed);
+    }
+    std::pmr::memory_resource* upstream_resource() const {
+        return upstream;
+    }
+};
+
+// Concurrent arena whose initial buffer of N bytes is part of the object.
+template<size_t N>
+class ConcurrentStorage: public ConcurrentArena {
+private:
+    alignas(std::max_align_t) uint8_t memory[N];
+
+public:
+    explicit ConcurrentStorage(std::pmr::memory_resource* upstream = std::pmr::get_default_resource()):
+            ConcurrentArena(memory, N, upstream) {}
+};
+
+// Per-thread sub-arena: takes slabs of slab_bytes from a shared ConcurrentArena and hands
+// out memory from them without any synchronization. It belongs to the thread that
+// created it; only that thread may allocate from it.
+//
+// Small objects are recycled through per-size free lists like PoolAllocator's. Any thread
+// may free memory back: the owner pushes onto its private free list, other threads push
+// onto a lock-free return list of the same size class, which the owner takes over in one
+// exchange when its private list runs dry. Since the return list is only ever emptied as
+// a whole, a pop can never race with a push of a reused chunk (no ABA problem).
+//
+// Larger or over-aligned allocations are bump-allocated and only reclaimed together with
+// the parent arena. The ThreadArena must outlive all containers that use it.
+class ThreadArena: public std::pmr::memory_resource {
+private:
+    ConcurrentArena* parent;
+    size_t slab_bytes;
+    uint8_t* pointer = nullptr;
+    uint8_t* end = nullptr;
+    std::thread::id owner;
+    void* free_lists[pool_classes] = {};
+    std::atomic<void*> remote[pool_classes] = {};
+
+    static size_t size_class(size_t bytes, size_t align) {
+        if (align > pool_granularity) {
+            return pool_classes;
+        }
+        return (std::max(bytes, sizeof(void*)) + pool_granularity - 1) / pool_granularity - 1;
+    }
+
+    uint8_t* bump(size_t sz, size_t align) {
+        auto h = reinterpret_cast<uintptr_t>(pointer);
+        size_t shift = (align - h % align) % align;
+        if (pointer == nullptr || shift + sz > static_cast<size_t>(end - pointer)) {
+            size_t bytes = std::max(slab_bytes, sz + align);
+            pointer = static_cast<uint8_t*>(parent->allocate(bytes, pool_granularity));
+            end = pointer + bytes;
+            h = reinterpret_cast<uintptr_t>(pointer);
+            shift = (align - h % align) % align;
+        }
+        pointer += shift;
+        uint8_t* ptr = pointer;
+        pointer += sz;
+        return ptr;
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t align) override {
+        size_t cls = size_class(bytes, align);
+        if (cls >= pool_classes) {
+            return bump(bytes, align);
+        }
+        void* p = free_lists[cls];
+        if (p == nullptr) {
+            p = remote[cls].exchange(nullptr, std::memory_order_acquire);
+        }
+        if (p != nullptr) {
+            free_lists[cls] = *static_cast<void**>(p);
+            return p;
+        }
+        return bump((cls + 1) * pool_granularity, pool_granularity);
+    }
+    void do_deallocate(void* p, size_t bytes, size_t align) override {
+        size_t cls = size_class(bytes, align);
+        if (cls >= pool_classes) return;
+        if (std::this_thread::get_id() == owner) {
+            *static_cast<void**>(p) = free_lists[cls];
+            free_lists[cls] = p;
+            return;
+        }
+        void* head = remote[cls].load(std::memory_order_relaxed);
+        do {
+            *static_cast<void**>(p) = head;
+        } while (!remote[cls].compare_exchange_weak(head, p, std::memory_order_release, std::memory_order_relaxed));
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+public:
+    explicit ThreadArena(ConcurrentArena& parent, size_t slab_bytes = 64 * 1024):
+            parent(&parent), slab_bytes(slab_bytes), owner(std::this_thread::get_id()) {}
+    ThreadArena(ThreadArena const&) = delete;
+    void operator=(ThreadArena const&) = delete;
+};
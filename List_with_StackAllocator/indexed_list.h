@@ -0,0 +1,431 @@
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+#include "list.h"
+
+// Sorted List with a skip-list index on top, for O(log n) expected lookup by key
+// (lower_bound, upper_bound, find) and by position (nth, index_of).
+//
+// The elements stay in an ordinary List; the index is a stack of express lanes whose
+// entries point at list positions. Every element gets an entry on the lowest lane with
+// probability 1/4, and an entry on the next lane with probability 1/4 of that, and so on.
+// Each entry knows how many elements lie between it and the next entry of its lane, which
+// makes positional access as cheap as search. Lane entries are allocated with the list's
+// allocator, rebound. List itself knows nothing about the index.
+//
+// Elements are only accessible as const, since changing one could break the order; equal
+// elements keep their insertion order.
+template <typename T, typename Compare = std::less<>, typename Allocator = std::allocator<T>>
+class IndexedList {
+    public:
+        using Base = List<T, Allocator>;
+        using const_iterator = typename Base::const_iterator;
+        using iterator = const_iterator;
+
+    private:
+        constexpr static size_t max_levels = 32;
+
+        // An entry of an express lane. Ranks count list positions from 1, so that the head
+        // of every lane sits at rank 0 and the end of the list at rank size() + 1; width is
+        // the rank of the next entry of the lane minus the rank of this one.
+        struct Lane {
+            const_iterator pos;
+            Lane* next = nullptr;
+            Lane* down = nullptr;
+            size_t width = 0;
+        };
+        using LaneAlloc = typename std::allocator_traits<Allocator>::template rebind_alloc<Lane>;
+        using LaneTraits = std::allocator_traits<LaneAlloc>;
+
+        Base lst;
+        Compare comp;
+        Lane heads[max_levels];
+        size_t levels = 0;
+        // Set when building the index ran out of memory. The list is intact and an index
+        // without lanes is still valid, so lookups just walk the list until the next insert
+        // or erase manages to rebuild it.
+        bool stale = false;
+        uint64_t seed = 0x9e3779b97f4a7c15;
+
+        LaneAlloc lane_alloc() const {
+            return LaneAlloc(lst.get_allocator());
+        }
+        size_t random_height();
+        void destroy_lanes();
+        // Builds the index over the current contents of the list in one pass. If that throws,
+        // the index is left empty and marked stale.
+        void rebuild() noexcept;
+
+        // Walks the lanes from the top, moving along each one while go(next entry, its rank)
+        // holds, and records the last entry passed on every lane in update and ranks. Returns
+        // the list position right after the last entry on the lowest lane, and its rank.
+        template <typename Go>
+        std::pair<const_iterator, size_t> descend(Go go, Lane** update, size_t* ranks) const;
+
+        template <typename V>
+        const_iterator insert_value(V&& val);
+
+    public:
+        IndexedList() = default;
+        explicit IndexedList(const Compare& comp, const Allocator& al = Allocator()): lst(al), comp(comp) {}
+        explicit IndexedList(const Allocator& al): lst(al) {}
+        IndexedList(const IndexedList& other): lst(other.lst), comp(other.comp) {
+            rebuild();
+        }
+        IndexedList(IndexedList&& other) noexcept: lst(std::move(other.lst)), comp(other.comp) {
+            std::swap(heads, other.heads);
+            std::swap(levels, other.levels);
+            std::swap(stale, other.stale);
+        }
+        ~IndexedList() {
+            destroy_lanes();
+        }
+
+        IndexedList& operator=(const IndexedList& other);
+        IndexedList& operator=(IndexedList&& other);
+
+        // Allocators are exchanged only if they propagate on swap; otherwise they have to be equal.
+        void swap(IndexedList& other) noexcept {
+            lst.swap(other.lst);
+            std::swap(comp, other.comp);
+            std::swap(heads, other.heads);
+            std::swap(levels, other.levels);
+            std::swap(stale, other.stale);
+            std::swap(seed, other.seed);
+        }
+        friend void swap(IndexedList& a, IndexedList& b) noexcept {
+            a.swap(b);
+        }
+
+        Allocator get_allocator() const {
+            return lst.get_allocator();
+        }
+        const Base& list() const {
+            return lst;
+        }
+        size_t size() const {
+            return lst.size();
+        }
+        bool empty() const {
+            return lst.size() == 0;
+        }
+
+        const_iterator begin() const {
+            return lst.begin();
+        }
+        const_iterator cbegin() const {
+            return lst.cbegin();
+        }
+        const_iterator end() const {
+            return lst.end();
+        }
+        const_iterator cend() const {
+            return lst.cend();
+        }
+
+        // Inserted after the elements equal to val.
+        const_iterator insert(const T& val) {
+            return insert_value(val);
+        }
+        const_iterator insert(T&& val) {
+            return insert_value(std::move(val));
+        }
+        const_iterator erase(const_iterator it);
+        void clear() {
+            destroy_lanes();
+            stale = false;
+            lst.clear();
+        }
+
+        template <typename K>
+        const_iterator lower_bound(const K& key) const;
+        template <typename K>
+        const_iterator upper_bound(const K& key) const;
+        template <typename K>
+        const_iterator find(const K& key) const {
+            const_iterator it = lower_bound(key);
+            if (it != end() && !comp(key, *it)) {
+                return it;
+            }
+            return end();
+        }
+
+        // The element at index k, or end() if k >= size().
+        const_iterator nth(size_t k) const;
+        // The index of the element at it, size() for end().
+        size_t index_of(const_iterator it) const;
+};
+
+// Geometric with p = 1/4: two random bits per level, capped one above the current height.
+template <typename T, typename Compare, typename Allocator>
+size_t IndexedList<T, Compare, Allocator>::random_height() {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    size_t height = std::countr_zero(seed | (uint64_t(1) << 62)) / 2;
+    return std::min({height, levels + 1, max_levels});
+}
+
+template <typename T, typename Compare, typename Allocator>
+void IndexedList<T, Compare, Allocator>::destroy_lanes() {
+    LaneAlloc alloc = lane_alloc();
+    for (size_t level = 0; level < levels; ++level) {
+        Lane* lane = heads[level].next;
+        while (lane != nullptr) {
+            Lane* next = lane->next;
+            LaneTraits::destroy(alloc, lane);
+            LaneTraits::deallocate(alloc, lane, 1);
+            lane = next;
+        }
+        heads[level] = Lane();
+    }
+    levels = 0;
+}
+
+template <typename T, typename Compare, typename Allocator>
+void IndexedList<T, Compare, Allocator>::rebuild() noexcept {
+    destroy_lanes();
+    stale = false;
+    LaneAlloc alloc = lane_alloc();
+    Lane* last[max_levels];
+    size_t last_ranks[max_levels];
+    try {
+        size_t rank = 1;
+        for (const_iterator it = lst.begin(); it != lst.end(); ++it, ++rank) {
+            size_t height = random_height();
+            for (; levels < height; ++levels) {
+                last[levels] = &heads[levels];
+                last_ranks[levels] = 0;
+            }
+            Lane* down = nullptr;
+            for (size_t level = 0; level < height; ++level) {
+                Lane* lane = LaneTraits::allocate(alloc, 1);
+                LaneTraits::construct(alloc, lane, Lane{it, nullptr, down, 0});
+                last[level]->next = lane;
+                last[level]->width = rank - last_ranks[level];
+                last[level] = lane;
+                last_ranks[level] = rank;
+                down = lane;
+            }
+        }
+        for (size_t level = 0; level < levels; ++level) {
+            last[level]->width = rank - last_ranks[level];
+        }
+    } catch (...) {
+        destroy_lanes();
+        stale = true;
+    }
+}
+
+template <typename T, typename Compare, typename Allocator>
+IndexedList<T, Compare, Allocator>& IndexedList<T, Compare, Allocator>::operator=(const IndexedList& other) {
+    if (this == &other) return *this;
+    // The lanes go first, while the allocator they came from is still there.
+    destroy_lanes();
+    try {
+        lst = other.lst;
+        comp = other.comp;
+    } catch (...) {
+        rebuild();
+        throw;
+    }
+    rebuild();
+    return *this;
+}
+
+template <typename T, typename Compare, typename Allocator>
+IndexedList<T, Compare, Allocator>& IndexedList<T, Compare, Allocator>::operator=(IndexedList&& other) {
+    if (this == &other) return *this;
+    using NodeTraits = std::allocator_traits<Allocator>;
+    bool steal = NodeTraits::propagate_on_container_move_assignment::value || lst.get_allocator() == other.lst.get_allocator();
+    destroy_lanes();
+    lst = std::move(other.lst);
+    comp = std::move(other.comp);
+    if (steal) {
+        // The nodes changed hands, and the lanes pointing at them with them.
+        std::swap(heads, other.heads);
+        std::swap(levels, other.levels);
+        std::swap(stale, other.stale);
+    } else {
+        other.clear();
+        rebuild();
+    }
+    return *this;
+}
+
+template <typename T, typename Compare, typename Allocator>
+template <typename Go>
+auto IndexedList<T, Compare, Allocator>::descend(Go go, Lane** update, size_t* ranks) const
+        -> std::pair<const_iterator, size_t> {
+    if (levels == 0) {
+        return {lst.begin(), 1};
+    }
+    Lane* cur = const_cast<Lane*>(&heads[levels - 1]);
+    size_t rank = 0;
+    for (size_t level = levels; level-- > 0;) {
+        while (cur->next != nullptr && go(cur->next, rank + cur->width)) {
+            rank += cur->width;
+            cur = cur->next;
+        }
+        update[level] = cur;
+        ranks[level] = rank;
+        if (level > 0) {
+            cur = rank == 0 ? const_cast<Lane*>(&heads[level - 1]) : cur->down;
+        }
+    }
+    if (rank == 0) {
+        return {lst.begin(), 1};
+    }
+    return {std::next(cur->pos), rank + 1};
+}
+
+template <typename T, typename Compare, typename Allocator>
+template <typename V>
+auto IndexedList<T, Compare, Allocator>::insert_value(V&& val) -> const_iterator {
+    if (stale) {
+        rebuild();
+    }
+    Lane* update[max_levels];
+    size_t ranks[max_levels];
+    auto [it, rank] = descend([this, &val](const Lane* next, size_t) {
+        return !comp(val, *next->pos);
+    }, update, ranks);
+    while (it != lst.end() && !comp(val, *it)) {
+        ++it;
+        ++rank;
+    }
+
+    // Everything is allocated before anything is linked.
+    size_t height = random_height();
+    LaneAlloc alloc = lane_alloc();
+    Lane* lanes[max_levels];
+    size_t made = 0;
+    const_iterator pos;
+    try {
+        for (; made < height; ++made) {
+            lanes[made] = LaneTraits::allocate(alloc, 1);
+        }
+        pos = lst.insert(it, std::forward<V>(val));
+    } catch (...) {
+        for (size_t k = 0; k < made; ++k) {
+            LaneTraits::deallocate(alloc, lanes[k], 1);
+        }
+        throw;
+    }
+
+    for (; levels < height; ++levels) {
+        heads[levels] = Lane{const_iterator(), nullptr, nullptr, lst.size()};
+        update[levels] = &heads[levels];
+        ranks[levels] = 0;
+    }
+    Lane* down = nullptr;
+    for (size_t level = 0; level < levels; ++level) {
+        Lane* prev = update[level];
+        if (level < height) {
+            size_t width = ranks[level] + prev->width + 1 - rank;
+            LaneTraits::construct(alloc, lanes[level], Lane{pos, prev->next, down, width});
+            prev->next = lanes[level];
+            prev->width = rank - ranks[level];
+            down = lanes[level];
+        } else {
+            ++prev->width;
+        }
+    }
+    return pos;
+}
+
+template <typename T, typename Compare, typename Allocator>
+auto IndexedList<T, Compare, Allocator>::erase(const_iterator it) -> const_iterator {
+    if (stale) {
+        rebuild();
+    }
+    size_t rank = index_of(it) + 1;
+    Lane* update[max_levels];
+    size_t ranks[max_levels];
+    descend([rank](const Lane*, size_t next_rank) {
+        return next_rank < rank;
+    }, update, ranks);
+    LaneAlloc alloc = lane_alloc();
+    for (size_t level = 0; level < levels; ++level) {
+        Lane* prev = update[level];
+        Lane* lane = prev->next;
+        if (lane != nullptr && ranks[level] + prev->width == rank) {
+            prev->width += lane->width - 1;
+            prev->next = lane->next;
+            LaneTraits::destroy(alloc, lane);
+            LaneTraits::deallocate(alloc, lane, 1);
+        } else {
+            --prev->width;
+        }
+    }
+    while (levels > 0 && heads[levels - 1].next == nullptr) {
+        heads[--levels] = Lane();
+    }
+    return lst.erase(it);
+}
+
+template <typename T, typename Compare, typename Allocator>
+template <typename K>
+auto IndexedList<T, Compare, Allocator>::lower_bound(const K& key) const -> const_iterator {
+    Lane* update[max_levels];
+    size_t ranks[max_levels];
+    const_iterator it = descend([this, &key](const Lane* next, size_t) {
+        return comp(*next->pos, key);
+    }, update, ranks).first;
+    while (it != lst.end() && comp(*it, key)) {
+        ++it;
+    }
+    return it;
+}
+
+template <typename T, typename Compare, typename Allocator>
+template <typename K>
+auto IndexedList<T, Compare, Allocator>::upper_bound(const K& key) const -> const_iterator {
+    Lane* update[max_levels];
+    size_t ranks[max_levels];
+    const_iterator it = descend([this, &key](const Lane* next, size_t) {
+        return !comp(key, *next->pos);
+    }, update, ranks).first;
+    while (it != lst.end() && !comp(key, *it)) {
+        ++it;
+    }
+    return it;
+}
+
+template <typename T, typename Compare, typename Allocator>
+auto IndexedList<T, Compare, Allocator>::nth(size_t k) const -> const_iterator {
+    if (k >= lst.size()) {
+        return lst.end();
+    }
+    Lane* update[max_levels];
+    size_t ranks[max_levels];
+    auto [it, rank] = descend([k](const Lane*, size_t next_rank) {
+        return next_rank <= k + 1;
+    }, update, ranks);
+    // The descent may pass the element itself and stop one position after it.
+    std::ptrdiff_t step = static_cast<std::ptrdiff_t>(k + 1) - static_cast<std::ptrdiff_t>(rank);
+    return std::next(it, step);
+}
+
+// Finds the first element equivalent to *it through the index, then walks over the
+// equivalent ones up to it.
+template <typename T, typename Compare, typename Allocator>
+size_t IndexedList<T, Compare, Allocator>::index_of(const_iterator it) const {
+    if (it == lst.end()) {
+        return lst.size();
+    }
+    Lane* update[max_levels];
+    size_t ranks[max_levels];
+    auto [p, rank] = descend([this, &it](const Lane* next, size_t) {
+        return comp(*next->pos, *it);
+    }, update, ranks);
+    while (p != it) {
+        ++p;
+        ++rank;
+    }
+    return rank - 1;
+}
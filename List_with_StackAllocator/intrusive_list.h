@@ -0,0 +1,263 @@
+#pragma once
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+// Links embedded in an object that can be put into an IntrusiveList. An object can be
+// in as many lists at once as it has hooks.
+struct ListHook {
+    ListHook* prev = nullptr;
+    ListHook* next = nullptr;
+
+    ListHook() = default;
+    // Copying an object does not copy its list membership.
+    ListHook(const ListHook&) {}
+    ListHook& operator=(const ListHook&) {
+        return *this;
+    }
+    bool is_linked() const {
+        return next != nullptr;
+    }
+};
+
+// Doubly linked list of objects that carry their own links in the member Hook, so
+// insertion and erasure only relink pointers and never allocate or copy. The list does
+// not own the objects: they have to stay alive while linked and be erased (or the list
+// cleared) before they are destroyed. T has to be a standard-layout type.
+//
+//     struct Event { int id; ListHook hook; };
+//     IntrusiveList<Event, &Event::hook> pending;
+template <typename T, ListHook T::* Hook>
+class IntrusiveList {
+    private:
+        size_t sz = 0;
+        // The sentinel closes the ring: an empty list's sentinel points at itself.
+        ListHook fakeNode;
+
+        static ListHook* hook_of(const T& obj) {
+            return const_cast<ListHook*>(&(obj.*Hook));
+        }
+        // Offset of Hook within T. offsetof cannot take a pointer to member, so the member is
+        // formed on storage that holds no T. That is formally undefined behaviour, the same
+        // known trick Boost.Intrusive uses for member hooks; it is only relied on for
+        // standard-layout types, where the compilers we support lay members out at fixed offsets.
+        static std::ptrdiff_t hook_offset() {
+            static_assert(std::is_standard_layout_v<T>, "IntrusiveList requires a standard-layout T");
+            alignas(T) static unsigned char storage[sizeof(T)];
+            auto obj = reinterpret_cast<T*>(storage);
+            return reinterpret_cast<unsigned char*>(&(obj->*Hook)) - storage;
+        }
+        // The object a hook is embedded in, found by subtracting the offset of the member.
+        static T* owner(ListHook* hook) {
+            return reinterpret_cast<T*>(reinterpret_cast<char*>(hook) - hook_offset());
+        }
+
+        void link_before(ListHook* pos, ListHook* hook) {
+            hook->prev = pos->prev;
+            hook->next = pos;
+            pos->prev->next = hook;
+            pos->prev = hook;
+            ++sz;
+        }
+        void unlink(ListHook* hook) {
+            hook->prev->next = hook->next;
+            hook->next->prev = hook->prev;
+            hook->prev = hook->next = nullptr;
+            --sz;
+        }
+
+        void take_links(IntrusiveList& other) {
+            if (other.sz == 0) return;
+            fakeNode.prev = other.fakeNode.prev;
+            fakeNode.next = other.fakeNode.next;
+            fakeNode.next->prev = &fakeNode;
+            fakeNode.prev->next = &fakeNode;
+            sz = other.sz;
+            other.fakeNode.prev = other.fakeNode.next = &other.fakeNode;
+            other.sz = 0;
+        }
+
+    public:
+        IntrusiveList() {
+            fakeNode.prev = fakeNode.next = &fakeNode;
+        }
+        IntrusiveList(const IntrusiveList&) = delete;
+        IntrusiveList& operator=(const IntrusiveList&) = delete;
+        IntrusiveList(IntrusiveList&& other) noexcept: IntrusiveList() {
+            take_links(other);
+        }
+        IntrusiveList& operator=(IntrusiveList&& other) noexcept {
+            if (this == &other) return *this;
+            clear();
+            take_links(other);
+            return *this;
+        }
+        ~IntrusiveList() {
+            clear();
+        }
+
+        size_t size() const {
+            return sz;
+        }
+        bool empty() const {
+            return sz == 0;
+        }
+
+        // Unlinks every object; the objects themselves are untouched.
+        void clear() {
+            ListHook* p = fakeNode.next;
+            while (p != &fakeNode) {
+                ListHook* next = p->next;
+                p->prev = p->next = nullptr;
+                p = next;
+            }
+            fakeNode.prev = fakeNode.next = &fakeNode;
+            sz = 0;
+        }
+
+        template <bool is_const>
+        class Iterator {
+        private:
+            ListHook* ptr = nullptr;
+        public:
+            using difference_type = std::ptrdiff_t;
+            using value_type = T;
+            using iterator_category = std::bidirectional_iterator_tag;
+            using reference = std::conditional_t<is_const, const T&, T&>;
+            using pointer = std::conditional_t<is_const, const T*, T*>;
+
+            Iterator() = default;
+            explicit Iterator(const ListHook* p): ptr(const_cast<ListHook*>(p)) {}
+            operator Iterator<true>() const {
+                return Iterator<true>(ptr);
+            }
+            Iterator& operator++() {
+                ptr = ptr->next;
+                return *this;
+            }
+            Iterator& operator--() {
+                ptr = ptr->prev;
+                return *this;
+            }
+            Iterator operator++(int) {
+                Iterator it = *this;
+                ++(*this);
+                return it;
+            }
+            Iterator operator--(int) {
+                Iterator it = *this;
+                --(*this);
+                return it;
+            }
+            ListHook* get_ptr() const {
+                return ptr;
+            }
+            bool operator==(const Iterator& other) const {
+                return ptr == other.ptr;
+            }
+            bool operator!=(const Iterator& other) const {
+                return ptr != other.ptr;
+            }
+            reference operator*() const {
+                return *owner(ptr);
+            }
+            pointer operator->() const {
+                return owner(ptr);
+            }
+        };
+
+        using const_iterator = Iterator<true>;
+        using iterator = Iterator<false>;
+        using const_reverse_iterator = std::reverse_iterator<Iterator<true>>;
+        using reverse_iterator = std::reverse_iterator<Iterator<false>>;
+
+        iterator begin() {
+            return iterator(fakeNode.next);
+        }
+        const_iterator begin() const {
+            return const_iterator(fakeNode.next);
+        }
+        const_iterator cbegin() const {
+            return const_iterator(fakeNode.next);
+        }
+
+        iterator end() {
+            return iterator(&fakeNode);
+        }
+        const_iterator end() const {
+            return const_iterator(&fakeNode);
+        }
+        const_iterator cend() const {
+            return const_iterator(&fakeNode);
+        }
+
+        reverse_iterator rbegin() {
+            return std::reverse_iterator(end());
+        }
+        const_reverse_iterator rbegin() const {
+            return std::reverse_iterator(cend());
+        }
+        const_reverse_iterator crbegin() const {
+            return std::reverse_iterator(cend());
+        }
+
+        reverse_iterator rend() {
+            return std::reverse_iterator(begin());
+        }
+        const_reverse_iterator rend() const {
+            return std::reverse_iterator(cbegin());
+        }
+        const_reverse_iterator crend() const {
+            return std::reverse_iterator(cbegin());
+        }
+
+        T& front() {
+            return *owner(fakeNode.next);
+        }
+        const T& front() const {
+            return *owner(fakeNode.next);
+        }
+        T& back() {
+            return *owner(fakeNode.prev);
+        }
+        const T& back() const {
+            return *owner(fakeNode.prev);
+        }
+
+        // The position of an object that is in this list.
+        iterator iterator_to(T& obj) {
+            return iterator(hook_of(obj));
+        }
+        const_iterator iterator_to(const T& obj) const {
+            return const_iterator(hook_of(obj));
+        }
+
+        // obj must not be linked through Hook already.
+        iterator insert(const_iterator it, T& obj) {
+            link_before(it.get_ptr(), hook_of(obj));
+            return iterator(hook_of(obj));
+        }
+        void push_back(T& obj) {
+            link_before(&fakeNode, hook_of(obj));
+        }
+        void push_front(T& obj) {
+            link_before(fakeNode.next, hook_of(obj));
+        }
+
+        iterator erase(const_iterator it) {
+            iterator next(it.get_ptr()->next);
+            unlink(it.get_ptr());
+            return next;
+        }
+        // Unlinks obj, which must be in this list, in O(1).
+        void erase(T& obj) {
+            unlink(hook_of(obj));
+        }
+        void pop_back() {
+            unlink(fakeNode.prev);
+        }
+        void pop_front() {
+            unlink(fakeNode.next);
+        }
+};
@@ -1,29 +1,163 @@
+#pragma once
 #include <iostream>
-template<size_t N>
-class StackStorage {
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <new>
+
+// Chunks handed out by PoolAllocator are multiples of pool_granularity bytes, one free
+// list per size, up to pool_classes * pool_granularity bytes.
+constexpr size_t pool_granularity = alignof(std::max_align_t);
+constexpr size_t pool_classes = 16;
+
+// Monotonic arena: allocations are carved from an initial buffer and, once it is used up,
+// from a chain of buffers taken from the upstream resource, each twice as large as the
+// previous one. Memory is only given back by release() and the destructor, except that
+// the most recent allocation can be undone (set_pointer, or deallocating it).
+// With std::pmr::null_memory_resource() as upstream the arena is strictly bounded.
+//
+// StackArena is a std::pmr::memory_resource whose type does not depend on the size of
+// the initial buffer, so std::pmr containers and polymorphic_allocator-based Lists and
+// Deques can share any StackStorage<N>.
+class StackArena: public std::pmr::memory_resource {
 private:
-    uint8_t memory[N];
-    uint8_t* pointer = memory;
+    struct Chunk {
+        Chunk* prev;
+        size_t bytes;
+    };
+
+    uint8_t* memory;
+    size_t memory_size;
+    uint8_t* pointer;
+    uint8_t* end;
+    Chunk* chunks = nullptr;
+    size_t next_chunk;
+    std::pmr::memory_resource* upstream;
+    // Intrusive free lists of PoolAllocator: the first bytes of a free chunk point to the next one.
+    void* free_lists[pool_classes] = {};
+
+public:
+    struct Stats {
+        size_t in_use = 0;             // bytes handed out and not rewound, alignment included
+        size_t high_water = 0;         // largest in_use seen
+        size_t alignment_waste = 0;    // padding bytes inserted for alignment, in total
+        size_t overflow_count = 0;     // buffers taken from upstream since the last release
+        size_t overflow_bytes = 0;     // their total size
+    };
+
+private:
+    Stats stats;
+
+    uint8_t* bump(size_t sz, size_t align) {
+        auto h = reinterpret_cast<uintptr_t>(pointer);
+        size_t shift = (align - h % align) % align;
+        if (shift + sz > static_cast<size_t>(end - pointer)) {
+            return nullptr;
+        }
+        pointer += shift;
+        uint8_t* ptr = pointer;
+        pointer += sz;
+        stats.alignment_waste += shift;
+        stats.in_use += shift + sz;
+        stats.high_water = std::max(stats.high_water, stats.in_use);
+        return ptr;
+    }
+    void grow(size_t sz, size_t align) {
+        size_t bytes = std::max(next_chunk, sizeof(Chunk) + sz + align);
+        void* raw = upstream->allocate(bytes, alignof(std::max_align_t));
+        chunks = new(raw) Chunk{chunks, bytes};
+        pointer = reinterpret_cast<uint8_t*>(chunks + 1);
+        end = static_cast<uint8_t*>(raw) + bytes;
+        next_chunk = bytes * 2;
+        ++stats.overflow_count;
+        stats.overflow_bytes += bytes;
+    }
+
+protected:
+    void* do_allocate(size_t bytes, size_t align) override {
+        return get_memory(bytes, align);
+    }
+    void do_deallocate(void* p, size_t bytes, size_t) override {
+        auto u = static_cast<uint8_t*>(p);
+        if (u + bytes == pointer) {
+            set_pointer(u);
+        }
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
 
 public:
-    StackStorage() = default;
-    ~StackStorage() = default;
-    StackStorage(StackStorage const&) = delete;
-    void operator=(StackStorage const&) = delete;
+    StackArena(uint8_t* buffer, size_t n, std::pmr::memory_resource* upstream = std::pmr::get_default_resource()):
+            memory(buffer), memory_size(n), pointer(buffer), end(buffer + n), next_chunk(2 * n), upstream(upstream) {}
+    ~StackArena() {
+        release();
+    }
+    StackArena(StackArena const&) = delete;
+    void operator=(StackArena const&) = delete;
     uint8_t* get_pointer() {
         return pointer;
     }
+    // Only meant to undo the latest allocation of the current buffer.
     void set_pointer(uint8_t* p) {
+        stats.in_use -= pointer - p;
         pointer = p;
     }
-    uint8_t* get_memory(int sz, int align) {
-        auto h = reinterpret_cast<uintptr_t>(pointer);
-        unsigned long shift = h % align;
-        pointer += (align - shift);
-        uint8_t* ptr = pointer;
-        pointer += sz;
-        return ptr;
+    uint8_t* get_memory(size_t sz, size_t align) {
+        uint8_t* p = bump(sz, align);
+        if (p == nullptr) {
+            grow(sz, align);
+            p = bump(sz, align);
+        }
+        return p;
+    }
+    // Gives all upstream buffers back and starts over from the inline buffer. Everything
+    // allocated from the arena, free lists included, becomes invalid.
+    void release() {
+        while (chunks != nullptr) {
+            Chunk* prev = chunks->prev;
+            upstream->deallocate(chunks, chunks->bytes, alignof(std::max_align_t));
+            chunks = prev;
+        }
+        pointer = memory;
+        end = memory + memory_size;
+        next_chunk = 2 * memory_size;
+        std::fill(free_lists, free_lists + pool_classes, nullptr);
+        stats.in_use = 0;
+        stats.overflow_count = 0;
+        stats.overflow_bytes = 0;
     }
+    const Stats& get_stats() const {
+        return stats;
+    }
+    std::pmr::memory_resource* upstream_resource() const {
+        return upstream;
+    }
+    void* pop_free(size_t cls) {
+        void* p = free_lists[cls];
+        if (p != nullptr) {
+            free_lists[cls] = *static_cast<void**>(p);
+        }
+        return p;
+    }
+    void push_free(size_t cls, void* p) {
+        *static_cast<void**>(p) = free_lists[cls];
+        free_lists[cls] = p;
+    }
+};
+
+// Arena whose initial buffer of N bytes is part of the object.
+template<size_t N>
+class StackStorage: public StackArena {
+private:
+    uint8_t memory[N];
+
+public:
+    explicit StackStorage(std::pmr::memory_resource* upstream = std::pmr::get_default_resource()):
+            StackArena(memory, N, upstream) {}
 };
 
 
@@ -49,14 +183,14 @@ public:
     }
     void deallocate(T* p, const size_t n) {
         auto u = reinterpret_cast<uint8_t*>(p);
-        if(u + n == st->get_pointer()) {
+        if(u + n * sizeof(T) == st->get_pointer()) {
             st->set_pointer(u);
         }
     }
 
     template <typename ...Args>
-    void construct(T* p, const Args& ...args) {
-        new(p) T(args...);
+    void construct(T* p, Args&& ...args) {
+        new(p) T(std::forward<Args>(args)...);
     }
 
     void destroy(T* p) {
@@ -83,6 +217,70 @@ bool operator!=(const StackAllocator<T1, N1>& a1, const StackAllocator<T2, N2>&
 }
 
 
+// Node allocator on top of a StackStorage: single objects come from per-size free lists,
+// so freed nodes are reused and allocate/deallocate are O(1). Free lists are refilled
+// from the arena, which falls back to its upstream resource once the inline buffer is
+// used up. Arrays, over-aligned and large objects skip the free lists.
+template<typename T, size_t N>
+class PoolAllocator {
+private:
+    StackStorage<N>* st;
+
+    constexpr static size_t chunk = (std::max(sizeof(T), sizeof(void*)) + pool_granularity - 1)
+                                    / pool_granularity * pool_granularity;
+    constexpr static size_t cls = chunk / pool_granularity - 1;
+    constexpr static bool pooled = alignof(T) <= pool_granularity && cls < pool_classes;
+
+public:
+    using value_type = T;
+    template <typename U, size_t M> friend class PoolAllocator;
+    PoolAllocator() = default;
+    ~PoolAllocator() = default;
+    PoolAllocator(StackStorage<N>& stt): st(&stt) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U, N>& other): st(other.st) {}
+
+    T* allocate(const size_t n) {
+        if (pooled && n == 1) {
+            void* p = st->pop_free(cls);
+            if (p == nullptr) {
+                p = st->get_memory(chunk, pool_granularity);
+            }
+            return static_cast<T*>(p);
+        }
+        return reinterpret_cast<T*>(st->get_memory(n * sizeof(T), alignof(T)));
+    }
+    void deallocate(T* p, const size_t n) {
+        if (pooled && n == 1) {
+            st->push_free(cls, p);
+            return;
+        }
+        auto u = reinterpret_cast<uint8_t*>(p);
+        if (u + n * sizeof(T) == st->get_pointer()) {
+            st->set_pointer(u);
+        }
+    }
+
+    template <typename U>
+    struct rebind {
+        using other = PoolAllocator<U, N>;
+    };
+
+    template <typename T1, size_t N1, typename T2, size_t N2>
+    friend bool operator==(const PoolAllocator<T1, N1>& a1, const PoolAllocator<T2, N2>& a2);
+};
+
+template <typename T1, size_t N1, typename T2, size_t N2>
+bool operator==(const PoolAllocator<T1, N1>& a1, const PoolAllocator<T2, N2>& a2) {
+    return (a1.st == a2.st && N1 == N2);
+}
+
+template <typename T1, size_t N1, typename T2, size_t N2>
+bool operator!=(const PoolAllocator<T1, N1>& a1, const PoolAllocator<T2, N2>& a2) {
+    return !(a1 == a2);
+}
+
+
 template <typename T, typename Allocator = std::allocator<T>>
 class List {
     private:
@@ -93,122 +291,177 @@ class List {
         };
         struct Node: BaseNode {
             T value;
-            Node() = default;
-            Node(const T& val): value(val) {};
+            template <typename... Args>
+            Node(Args&&... args): value(std::forward<Args>(args)...) {};
+        };
+        // Nodes allocated together by a bulk operation. The array is given back in one call
+        // once the last of its nodes is released, wherever the nodes have moved since; until
+        // then released nodes are kept on the slab's free list and reused for new elements.
+        struct Slab {
+            Node* nodes;
+            size_t n;
+            size_t live;
+            // Number of slab tables listing the slab, the record is freed when it drops to 0.
+            size_t refs;
+            Node* free;
         };
-        BaseNode fakeNode;
+        // The slabs whose nodes can be in this list, sorted by address: a node's slab is found
+        // by binary search rather than stored in every node. A slab released through another
+        // list stays here with live == 0 until the next insertion prunes it.
+        struct SlabTable {
+            Slab** slabs = nullptr;
+            size_t count = 0;
+            size_t capacity = 0;
+            // The slab that last got a node back, new nodes are taken from it first.
+            Slab* spare = nullptr;
+            // Set when a node went back to a slab, cleared when a search finds no free nodes.
+            bool has_free = false;
+        };
+        // The sentinel closes the ring: an empty list's sentinel points at itself.
+        BaseNode fakeNode{&fakeNode, &fakeNode};
 
     public:
         using AllocTraits = std::allocator_traits<Allocator>;
         using NodeAlloc = typename AllocTraits::template rebind_alloc<Node>;
         using NodeTraits = std::allocator_traits<NodeAlloc>;
+        using SlabAlloc = typename AllocTraits::template rebind_alloc<Slab>;
+        using SlabTraits = std::allocator_traits<SlabAlloc>;
+        using SlabPtrAlloc = typename AllocTraits::template rebind_alloc<Slab*>;
+        using SlabPtrTraits = std::allocator_traits<SlabPtrAlloc>;
 
     private:
         NodeAlloc alloc;
+        SlabTable slab_table;
+
+        // Slabs are capped so that a few surviving nodes can't keep a large array alive.
+        constexpr static size_t slab_nodes = std::max<size_t>(1, 64 * 1024 / sizeof(Node));
+
+        // Builds n nodes in slabs, make(node) constructs the i-th one in turn, and links
+        // them in at the back in a single pass. Nothing is linked if make throws.
+        template <typename F>
+        void append_bulk(size_t n, F make);
+        template <typename F>
+        Slab* build_slab(size_t n, F& make);
+        Node* take_node();
+        void release_node(Node* node);
+
+        // Index of the live slab holding node, slab_table.count if there is none.
+        size_t find_slab(const Node* node) const;
+        // Makes room for extra more slabs, pruning dead ones first.
+        void reserve_slabs(size_t extra);
+        // Lists slab unless it is listed already; room has to be reserved.
+        void add_slab(Slab* slab) noexcept;
+        void remove_slab(size_t i) noexcept;
+        void drop_slab(Slab* slab) noexcept;
+        // Lists the slabs of other, before nodes are taken from it.
+        void adopt_slabs(const List& other);
+        void adopt_slab_of(const List& other, const Node* node);
+        void free_slabs() noexcept;
 
     public:
         List() = default;
         List(size_t n) {
-            try{
-                for(size_t i = 0; i < n; i++) {
-                    emplace_back();
-                }
-            } catch(...) {
-                while(sz > 0) {
-                    pop_back();
-                }
-                throw;
-            }
+            append_bulk(n, [this](Node* node) {
+                NodeTraits::construct(alloc, node);
+            });
         };
         List(size_t n, const T& val) {
-            try{
-                for(size_t i = 0; i < n; i++) {
-                    push_back(val);
-                }
-            } catch(...) {
-                while(sz > 0) {
-                    pop_back();
-                }
-                throw;
-            }
-
-        };
-        List(Allocator al) {
-            alloc = NodeAlloc(al);
+            append_bulk(n, [this, &val](Node* node) {
+                NodeTraits::construct(alloc, node, val);
+            });
         };
-        List(const size_t n, Allocator al)  {
-            alloc = NodeAlloc(al);
-            try {
-                for(size_t i = 0; i < n; i++) {
-                    emplace_back();
-                }
-            }   catch(...) {
-                while(sz > 0) {
-                    pop_back();
-                }
-                throw;
-            }
+        List(Allocator al): alloc(al) {};
+        List(const size_t n, Allocator al): alloc(al) {
+            append_bulk(n, [this](Node* node) {
+                NodeTraits::construct(alloc, node);
+            });
         };
-        List(size_t n, const T& val, Allocator al){
-            alloc = NodeAlloc(al);
-            try {
-                for(size_t i = 0; i < n; i++) {
-                    push_back(val);
-                }
-            }   catch(...) {
-                while(sz > 0) {
-                    pop_back();
-                }
-                throw;
-            }
+        List(size_t n, const T& val, Allocator al): alloc(al) {
+            append_bulk(n, [this, &val](Node* node) {
+                NodeTraits::construct(alloc, node, val);
+            });
         }
 
-        List(const List& lst): alloc(NodeTraits::select_on_container_copy_construction(lst.alloc)){
-            try {
-                for(auto p = lst.begin(); p != lst.end(); ++p) {
-                    push_back(*p);
-                }
-            }   catch(...) {
-                while(sz > 0) {
-                    pop_back();
-                }
-                throw;
+        List(const List& lst): List(lst, NodeTraits::select_on_container_copy_construction(lst.alloc)) {};
+
+        List(List&& other) noexcept: alloc(std::move(other.alloc)) {
+            swap_nodes(other);
+        }
+
+        // Steals the nodes if the allocators are equal, moves the elements one by one otherwise.
+        List(List&& other, const Allocator& al): alloc(al) {
+            if (alloc == other.alloc) {
+                swap_nodes(other);
+                return;
             }
+            auto p = other.begin();
+            append_bulk(other.sz, [this, &p](Node* node) {
+                NodeTraits::construct(alloc, node, std::move(*p++));
+            });
+        }
 
+        List(const List& lst, const Allocator& al): alloc(al) {
+            auto p = lst.begin();
+            append_bulk(lst.sz, [this, &p](Node* node) {
+                NodeTraits::construct(alloc, node, *p++);
+            });
         };
 
         ~List() {
-            while(sz > 0) {
-                pop_back();
-            }
+            clear();
+            free_slabs();
         };
 
+        // The copy is built with the allocator this list ends up with, so only the nodes
+        // change hands (and the allocators too, when they propagate). Allocators that don't
+        // propagate, such as std::pmr::polymorphic_allocator, are never assigned.
         List& operator=(const List& lst) {
-            auto copy_alloc = alloc;
-            if (NodeTraits::propagate_on_container_copy_assignment::value) alloc = lst.alloc;
-            size_t t = 0;
-            try {
-                for (auto p = lst.begin(); p != lst.end(); ++p) {
-                    push_back(*p);
-                    ++t;
-                }
-            }   catch(...) {
-                while(t > 0) {
-                    pop_back();
-                    --t;
-                }
-                alloc = copy_alloc;
-                throw;
-            }
-            alloc = copy_alloc;
-            while (sz > lst.sz) {
-                pop_front();
+            if (this == &lst) return *this;
+            if constexpr (NodeTraits::propagate_on_container_copy_assignment::value) {
+                List copy(lst, lst.alloc);
+                swap_nodes(copy);
+                std::swap(alloc, copy.alloc);
+            } else {
+                List copy(lst, alloc);
+                swap_nodes(copy);
             }
-            if (NodeTraits::propagate_on_container_copy_assignment::value) alloc = lst.alloc;
             return *this;
         };
 
-        Allocator get_allocator() {
+        // Allocators are exchanged only if they propagate on swap; otherwise they have to be equal.
+        void swap(List& other) noexcept {
+            if constexpr (NodeTraits::propagate_on_container_swap::value) {
+                std::swap(alloc, other.alloc);
+            }
+            swap_nodes(other);
+        }
+
+        List& operator=(List&& other) noexcept(NodeTraits::propagate_on_container_move_assignment::value
+                                               || NodeTraits::is_always_equal::value) {
+            if (this == &other) return *this;
+            if constexpr (NodeTraits::propagate_on_container_move_assignment::value) {
+                clear();
+                free_slabs();
+                alloc = std::move(other.alloc);
+                swap_nodes(other);
+            } else {
+                if (alloc == other.alloc) {
+                    clear();
+                    swap_nodes(other);
+                } else {
+                    // Nodes can't change hands between unequal allocators.
+                    List tmp(std::move(other), alloc);
+                    swap_nodes(tmp);
+                }
+            }
+            return *this;
+        }
+
+        friend void swap(List& a, List& b) noexcept {
+            a.swap(b);
+        }
+
+        Allocator get_allocator() const {
             return alloc;
         }
 
@@ -216,70 +469,82 @@ class List {
             return sz;
         }
 
-        void emplace_back() {
-            Node* node = NodeTraits::allocate(alloc, 1);
+        // Constructs an element in a new node linked in before after.
+        template <typename... Args>
+        Node* push_before(BaseNode* after, Args&&... args) {
+            Node* node = take_node();
             try {
-                NodeTraits::construct(alloc, node);
-                if (sz == 0) {
-                    node->prev = &fakeNode;
-                    fakeNode.next = node;
-                }
-                else {
-                    node->prev = fakeNode.prev;
-                    fakeNode.prev->next = node;
-                }
-                node->next = &fakeNode;
-                fakeNode.prev = node;
-                ++sz;
-            }   catch(...) {
-                NodeTraits::deallocate(alloc, static_cast<Node*>(node), 1);
+                NodeTraits::construct(alloc, node, std::forward<Args>(args)...);
+            } catch(...) {
+                release_node(node);
                 throw;
             }
+            node->prev = after->prev;
+            node->next = after;
+            after->prev->next = node;
+            after->prev = node;
+            ++sz;
+            return node;
         }
 
-        void push_before(BaseNode* after, const T& val) {
-            Node* node = NodeTraits::allocate(alloc, 1);
-            try {
-                NodeTraits::construct(alloc, node, val);
-                if (sz == 0) {
-                    node->prev = after;
-                    after->next = node;
-                }
-                else {
-                    node->prev = after->prev;
-                    after->prev->next = node;
+        // Exchanges the elements, the first and last nodes are re-pointed at the other sentinel.
+        void swap_nodes(List& other) noexcept {
+            std::swap(fakeNode, other.fakeNode);
+            std::swap(sz, other.sz);
+            std::swap(slab_table, other.slab_table);
+            for (List* lst : {this, &other}) {
+                if (lst->sz == 0) {
+                    lst->fakeNode.prev = lst->fakeNode.next = &lst->fakeNode;
+                } else {
+                    lst->fakeNode.next->prev = &lst->fakeNode;
+                    lst->fakeNode.prev->next = &lst->fakeNode;
                 }
-                node->next = after;
-                after->prev = node;
-                ++sz;
-            } catch(...) {
-                NodeTraits::deallocate(alloc, static_cast<Node*>(node), 1);
-                throw;
             }
         }
 
         void pop(BaseNode* ptr) {
-            BaseNode* d = ptr;
-            if (sz == 1) {
-                fakeNode.prev = nullptr;
-                fakeNode.next = nullptr;
-            }
-            else {
-                ptr->prev->next = ptr->next;
-                ptr->next->prev = ptr->prev;
-            }
-            NodeTraits::destroy(alloc, static_cast<Node*>(d));
-            NodeTraits::deallocate(alloc, static_cast<Node*>(d), 1);
+            ptr->prev->next = ptr->next;
+            ptr->next->prev = ptr->prev;
+            NodeTraits::destroy(alloc, static_cast<Node*>(ptr));
+            release_node(static_cast<Node*>(ptr));
             --sz;
         }
 
+        // One sweep over the nodes; destructors are skipped for trivially destructible T.
+        void clear() {
+            BaseNode* p = fakeNode.next;
+            while (p != &fakeNode) {
+                BaseNode* next = p->next;
+                if constexpr (!std::is_trivially_destructible_v<T>) {
+                    NodeTraits::destroy(alloc, static_cast<Node*>(p));
+                }
+                release_node(static_cast<Node*>(p));
+                p = next;
+            }
+            fakeNode.prev = fakeNode.next = &fakeNode;
+            sz = 0;
+        }
+
+        template <typename... Args>
+        T& emplace_back(Args&&... args) {
+            return push_before(&fakeNode, std::forward<Args>(args)...)->value;
+        }
+        template <typename... Args>
+        T& emplace_front(Args&&... args) {
+            return push_before(fakeNode.next, std::forward<Args>(args)...)->value;
+        }
 
         void push_back(const T& val) {
             push_before(&fakeNode, val);
         }
+        void push_back(T&& val) {
+            push_before(&fakeNode, std::move(val));
+        }
         void push_front(const T& val) {
-            if (sz == 0) push_before(&fakeNode, val);
-            else push_before(fakeNode.next, val);
+            push_before(fakeNode.next, val);
+        }
+        void push_front(T&& val) {
+            push_before(fakeNode.next, std::move(val));
         }
 
         void pop_back() {
@@ -390,9 +655,16 @@ class List {
             return std::reverse_iterator(cbegin());
         };
 
+        template <typename... Args>
+        iterator emplace(const_iterator it, Args&&... args) {
+            return iterator(push_before(it.get_ptr(), std::forward<Args>(args)...));
+        }
+
         iterator insert(const_iterator it, const T& val) {
-            push_before(it.get_ptr(), val);
-            return iterator(it.get_ptr());
+            return iterator(push_before(it.get_ptr(), val));
+        };
+        iterator insert(const_iterator it, T&& val) {
+            return iterator(push_before(it.get_ptr(), std::move(val)));
         };
 
         iterator erase(const_iterator it) {
@@ -400,6 +672,476 @@ class List {
             pop(it.get_ptr());
             return copy;
         };
+
+        // Node relinking. None of these copy or move elements, and the only allocation is
+        // for listing another list's slabs before taking nodes from it, so if that throws
+        // nothing has moved. Nodes taken from another list require its allocator to be
+        // equal to this one's.
+
+        // Moves all elements of other before it.
+        void splice(const_iterator it, List& other) {
+            if (&other == this || other.sz == 0) return;
+            adopt_slabs(other);
+            size_t n = other.sz;
+            transfer(it.get_ptr(), other.fakeNode.next, &other.fakeNode);
+            sz += n;
+            other.sz = 0;
+        }
+        void splice(const_iterator it, List&& other) {
+            splice(it, other);
+        }
+        // Moves the element at pos of other before it.
+        void splice(const_iterator it, List& other, const_iterator pos) {
+            BaseNode* node = pos.get_ptr();
+            if (node == it.get_ptr() || node->next == it.get_ptr()) return;
+            if (&other != this) {
+                adopt_slab_of(other, static_cast<Node*>(node));
+            }
+            transfer(it.get_ptr(), node, node->next);
+            ++sz;
+            --other.sz;
+        }
+        void splice(const_iterator it, List&& other, const_iterator pos) {
+            splice(it, other, pos);
+        }
+        // Moves [first, last) of other before it; linear in the length of the range
+        // when other is a different list, because the sizes have to be updated.
+        void splice(const_iterator it, List& other, const_iterator first, const_iterator last) {
+            if (first == last) return;
+            if (&other != this) {
+                adopt_slabs(other);
+                size_t n = std::distance(first, last);
+                sz += n;
+                other.sz -= n;
+            }
+            transfer(it.get_ptr(), first.get_ptr(), last.get_ptr());
+        }
+        void splice(const_iterator it, List&& other, const_iterator first, const_iterator last) {
+            splice(it, other, first, last);
+        }
+
+        // Merges the sorted other into this sorted list; equal elements of this list come first.
+        template <typename Compare = std::less<>>
+        void merge(List& other, Compare comp = Compare()) {
+            if (&other == this) return;
+            adopt_slabs(other);
+            BaseNode* p = fakeNode.next;
+            while (other.sz > 0) {
+                BaseNode* q = other.fakeNode.next;
+                while (p != &fakeNode && !comp(value(q), value(p))) {
+                    p = p->next;
+                }
+                if (p == &fakeNode) {
+                    splice(const_iterator(p), other);
+                    return;
+                }
+                // Take the whole run of other that goes before p.
+                BaseNode* last = q->next;
+                size_t n = 1;
+                while (last != &other.fakeNode && comp(value(last), value(p))) {
+                    last = last->next;
+                    ++n;
+                }
+                transfer(p, q, last);
+                sz += n;
+                other.sz -= n;
+            }
+        }
+        template <typename Compare = std::less<>>
+        void merge(List&& other, Compare comp = Compare()) {
+            merge(other, comp);
+        }
+
+        // Stable bottom-up merge sort: runs of width 1, 2, 4, ... are merged along the next
+        // links, then the prev links are restored in one pass. If comp throws, every element
+        // stays in the list, in an unspecified order.
+        template <typename Compare = std::less<>>
+        void sort(Compare comp = Compare()) {
+            if (sz < 2) return;
+            BaseNode* head = fakeNode.next;
+            BaseNode* tail = nullptr;
+            BaseNode* p = nullptr;
+            BaseNode* q = nullptr;
+            size_t psize = 0;
+            fakeNode.prev->next = nullptr;
+            try {
+                for (size_t width = 1; ; width *= 2) {
+                    p = head;
+                    tail = nullptr;
+                    head = nullptr;
+                    size_t merges = 0;
+                    while (p != nullptr) {
+                        ++merges;
+                        q = p;
+                        for (psize = 0; psize < width && q != nullptr; ++psize) {
+                            q = q->next;
+                        }
+                        size_t qsize = width;
+                        while (psize > 0 || (qsize > 0 && q != nullptr)) {
+                            BaseNode* e;
+                            if (psize > 0 && (qsize == 0 || q == nullptr || !comp(value(q), value(p)))) {
+                                e = p;
+                                p = p->next;
+                                --psize;
+                            } else {
+                                e = q;
+                                q = q->next;
+                                --qsize;
+                            }
+                            if (tail != nullptr) {
+                                tail->next = e;
+                            } else {
+                                head = e;
+                            }
+                            tail = e;
+                        }
+                        p = q;
+                    }
+                    tail->next = nullptr;
+                    if (merges <= 1) break;
+                }
+            } catch (...) {
+                // The merged nodes end at tail; the rest of the p run still has its own next
+                // links, and so have the q run and the unmerged runs behind it.
+                for (; psize > 0; --psize) {
+                    BaseNode* next = p->next;
+                    if (tail != nullptr) {
+                        tail->next = p;
+                    } else {
+                        head = p;
+                    }
+                    tail = p;
+                    p = next;
+                }
+                if (tail != nullptr) {
+                    tail->next = q;
+                } else {
+                    head = q;
+                }
+                close_chain(head);
+                throw;
+            }
+            close_chain(head);
+        }
+
+        // Removes all but the first element of every run of equal elements.
+        template <typename BinaryPredicate = std::equal_to<>>
+        size_t unique(BinaryPredicate pred = BinaryPredicate()) {
+            size_t removed = 0;
+            if (sz == 0) return removed;
+            BaseNode* p = fakeNode.next;
+            while (p->next != &fakeNode) {
+                if (pred(value(p), value(p->next))) {
+                    pop(p->next);
+                    ++removed;
+                } else {
+                    p = p->next;
+                }
+            }
+            return removed;
+        }
+
+        void reverse() noexcept {
+            BaseNode* node = &fakeNode;
+            do {
+                std::swap(node->prev, node->next);
+                node = node->prev;
+            } while (node != &fakeNode);
+        }
+
+        template <typename Predicate>
+        size_t remove_if(Predicate pred) {
+            size_t removed = 0;
+            for (BaseNode* p = fakeNode.next; p != &fakeNode; ) {
+                BaseNode* next = p->next;
+                if (pred(value(p))) {
+                    pop(p);
+                    ++removed;
+                }
+                p = next;
+            }
+            return removed;
+        }
+        // val may be an element of this list: the node holding it is erased last.
+        size_t remove(const T& val) {
+            size_t removed = 0;
+            BaseNode* self = nullptr;
+            for (BaseNode* p = fakeNode.next; p != &fakeNode; ) {
+                BaseNode* next = p->next;
+                if (value(p) == val) {
+                    if (&value(p) == std::addressof(val)) {
+                        self = p;
+                    } else {
+                        pop(p);
+                    }
+                    ++removed;
+                }
+                p = next;
+            }
+            if (self != nullptr) {
+                pop(self);
+            }
+            return removed;
+        }
+
+    private:
+        static T& value(BaseNode* node) {
+            return static_cast<Node*>(node)->value;
+        }
+
+        // Unlinks [first, last) and links it in before pos, which must not be inside the range.
+        static void transfer(BaseNode* pos, BaseNode* first, BaseNode* last) {
+            if (pos == last) return;
+            BaseNode* tail = last->prev;
+            first->prev->next = last;
+            last->prev = first->prev;
+            first->prev = pos->prev;
+            tail->next = pos;
+            pos->prev->next = first;
+            pos->prev = tail;
+        }
+
+        // Makes the nullptr-terminated next chain from head the whole list again, restoring
+        // the prev links and the sentinel.
+        void close_chain(BaseNode* head) {
+            BaseNode* prev = &fakeNode;
+            for (BaseNode* node = head; node != nullptr; node = node->next) {
+                node->prev = prev;
+                prev = node;
+            }
+            fakeNode.next = head;
+            fakeNode.prev = prev;
+            prev->next = &fakeNode;
+        }
     };
 
+template <typename T, typename Allocator>
+template <typename F>
+void List<T, Allocator>::append_bulk(size_t n, F make) {
+    if (n == 0) return;
+    reserve_slabs((n + slab_nodes - 1) / slab_nodes);
+    // Finished slabs are chained behind a local sentinel until all of them are built.
+    BaseNode chain{&chain, &chain};
+    try {
+        for (size_t built = 0; built < n; ) {
+            size_t k = std::min(slab_nodes, n - built);
+            Slab* slab = build_slab(k, make);
+            add_slab(slab);
+            BaseNode* prev = chain.prev;
+            for (size_t i = 0; i < k; ++i) {
+                slab->nodes[i].prev = prev;
+                prev->next = slab->nodes + i;
+                prev = slab->nodes + i;
+            }
+            prev->next = &chain;
+            chain.prev = prev;
+            built += k;
+        }
+    } catch(...) {
+        BaseNode* p = chain.next;
+        while (p != &chain) {
+            BaseNode* next = p->next;
+            NodeTraits::destroy(alloc, static_cast<Node*>(p));
+            release_node(static_cast<Node*>(p));
+            p = next;
+        }
+        // A constructor that throws never runs the destructor, which would free the table.
+        if (slab_table.count == 0) {
+            free_slabs();
+        }
+        throw;
+    }
+    chain.next->prev = fakeNode.prev;
+    fakeNode.prev->next = chain.next;
+    chain.prev->next = &fakeNode;
+    fakeNode.prev = chain.prev;
+    sz += n;
+}
+
+// Allocates a slab of n nodes and constructs them with make. If make throws, the nodes
+// built so far are destroyed and the slab is given back.
+template <typename T, typename Allocator>
+template <typename F>
+auto List<T, Allocator>::build_slab(size_t n, F& make) -> Slab* {
+    SlabAlloc slab_alloc(alloc);
+    Slab* slab = SlabTraits::allocate(slab_alloc, 1);
+    Node* nodes;
+    try {
+        nodes = NodeTraits::allocate(alloc, n);
+    } catch(...) {
+        SlabTraits::deallocate(slab_alloc, slab, 1);
+        throw;
+    }
+    size_t i = 0;
+    try {
+        for (; i < n; ++i) {
+            make(nodes + i);
+        }
+    } catch(...) {
+        while (i > 0) {
+            NodeTraits::destroy(alloc, nodes + --i);
+        }
+        NodeTraits::deallocate(alloc, nodes, n);
+        SlabTraits::deallocate(slab_alloc, slab, 1);
+        throw;
+    }
+    SlabTraits::construct(slab_alloc, slab, Slab{nodes, n, n, 0, nullptr});
+    return slab;
+}
 
+// Storage for one node: a free node of the spare slab if there is one, a new node otherwise.
+template <typename T, typename Allocator>
+auto List<T, Allocator>::take_node() -> Node* {
+    Slab* slab = slab_table.spare;
+    if ((slab == nullptr || slab->free == nullptr) && slab_table.has_free) {
+        // Every search either finds a node released since the last one or clears has_free.
+        slab = nullptr;
+        for (size_t i = 0; i < slab_table.count && slab == nullptr; ++i) {
+            if (slab_table.slabs[i]->free != nullptr) {
+                slab = slab_table.slabs[i];
+            }
+        }
+        slab_table.spare = slab;
+        slab_table.has_free = slab != nullptr;
+    }
+    if (slab == nullptr || slab->free == nullptr) {
+        return NodeTraits::allocate(alloc, 1);
+    }
+    Node* node = slab->free;
+    slab->free = *std::launder(reinterpret_cast<Node**>(node));
+    ++slab->live;
+    return node;
+}
+
+// Gives back the storage of a destroyed node. Its slab is looked up by address, so the
+// node itself is not read.
+template <typename T, typename Allocator>
+void List<T, Allocator>::release_node(Node* node) {
+    size_t i = find_slab(node);
+    if (i == slab_table.count) {
+        NodeTraits::deallocate(alloc, node, 1);
+        return;
+    }
+    Slab* slab = slab_table.slabs[i];
+    if (--slab->live > 0) {
+        // The free list is threaded through the released nodes.
+        ::new(static_cast<void*>(node)) Node*(slab->free);
+        slab->free = node;
+        slab_table.spare = slab;
+        slab_table.has_free = true;
+        return;
+    }
+    NodeTraits::deallocate(alloc, slab->nodes, slab->n);
+    slab->free = nullptr;
+    remove_slab(i);
+    drop_slab(slab);
+}
+
+template <typename T, typename Allocator>
+size_t List<T, Allocator>::find_slab(const Node* node) const {
+    std::less<const Node*> less;
+    Slab** first = slab_table.slabs;
+    Slab** last = first + slab_table.count;
+    Slab** it = std::upper_bound(first, last, node, [&less](const Node* p, const Slab* slab) {
+        return less(p, slab->nodes);
+    });
+    if (it == first) {
+        return slab_table.count;
+    }
+    const Slab* slab = *--it;
+    if (slab->live == 0 || !less(node, slab->nodes + slab->n)) {
+        return slab_table.count;
+    }
+    return it - first;
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::reserve_slabs(size_t extra) {
+    // Dead slabs go first: the slabs about to be added may reuse their memory.
+    size_t kept = 0;
+    for (size_t i = 0; i < slab_table.count; ++i) {
+        Slab* slab = slab_table.slabs[i];
+        if (slab->live > 0) {
+            slab_table.slabs[kept++] = slab;
+            continue;
+        }
+        if (slab_table.spare == slab) {
+            slab_table.spare = nullptr;
+        }
+        drop_slab(slab);
+    }
+    slab_table.count = kept;
+    if (slab_table.count + extra <= slab_table.capacity) return;
+    size_t capacity = std::max(slab_table.count + extra, 2 * slab_table.capacity);
+    SlabPtrAlloc ptr_alloc(alloc);
+    Slab** slabs = SlabPtrTraits::allocate(ptr_alloc, capacity);
+    std::copy(slab_table.slabs, slab_table.slabs + slab_table.count, slabs);
+    if (slab_table.slabs != nullptr) {
+        SlabPtrTraits::deallocate(ptr_alloc, slab_table.slabs, slab_table.capacity);
+    }
+    slab_table.slabs = slabs;
+    slab_table.capacity = capacity;
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::add_slab(Slab* slab) noexcept {
+    Slab** first = slab_table.slabs;
+    Slab** last = first + slab_table.count;
+    Slab** it = std::lower_bound(first, last, slab, [](const Slab* a, const Slab* b) {
+        return std::less<const Node*>()(a->nodes, b->nodes);
+    });
+    if (it != last && *it == slab) return;
+    std::copy_backward(it, last, last + 1);
+    *it = slab;
+    ++slab_table.count;
+    ++slab->refs;
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::remove_slab(size_t i) noexcept {
+    if (slab_table.spare == slab_table.slabs[i]) {
+        slab_table.spare = nullptr;
+    }
+    std::copy(slab_table.slabs + i + 1, slab_table.slabs + slab_table.count, slab_table.slabs + i);
+    --slab_table.count;
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::drop_slab(Slab* slab) noexcept {
+    if (--slab->refs > 0) return;
+    SlabAlloc slab_alloc(alloc);
+    SlabTraits::destroy(slab_alloc, slab);
+    SlabTraits::deallocate(slab_alloc, slab, 1);
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::adopt_slabs(const List& other) {
+    if (other.slab_table.count == 0) return;
+    reserve_slabs(other.slab_table.count);
+    for (size_t i = 0; i < other.slab_table.count; ++i) {
+        if (other.slab_table.slabs[i]->live > 0) {
+            add_slab(other.slab_table.slabs[i]);
+        }
+    }
+}
+
+template <typename T, typename Allocator>
+void List<T, Allocator>::adopt_slab_of(const List& other, const Node* node) {
+    size_t i = other.find_slab(node);
+    if (i == other.slab_table.count) return;
+    reserve_slabs(1);
+    add_slab(other.slab_table.slabs[i]);
+}
+
+// Unlists every slab; slabs that still have nodes in other lists stay listed there.
+template <typename T, typename Allocator>
+void List<T, Allocator>::free_slabs() noexcept {
+    for (size_t i = 0; i < slab_table.count; ++i) {
+        drop_slab(slab_table.slabs[i]);
+    }
+    if (slab_table.slabs != nullptr) {
+        SlabPtrAlloc ptr_alloc(alloc);
+        SlabPtrTraits::deallocate(ptr_alloc, slab_table.slabs, slab_table.capacity);
+    }
+    slab_table = SlabTable();
+}
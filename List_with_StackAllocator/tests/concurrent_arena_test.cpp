@@ -0,0 +1,137 @@
+// ConcurrentArena and ThreadArena under several threads: blocks allocated concurrently
+// from one arena never overlap and are aligned, also once the buffer overflows; blocks
+// of a ThreadArena freed by another thread come back to its owner, never while they are
+// still in use; and Lists built on per-thread arenas in parallel keep their elements.
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "../concurrent_arena.h"
+
+constexpr size_t threads = 4;
+
+struct Block {
+    uint8_t* p;
+    size_t bytes;
+};
+
+void test_shared_allocation() {
+    auto buffer = std::make_unique<uint8_t[]>(1 << 16);
+    ConcurrentArena arena(buffer.get(), 1 << 16);
+    std::vector<Block> blocks[threads];
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&arena, &blocks, t] {
+            for (size_t i = 0; i < 2000; ++i) {
+                size_t bytes = 1 + (i * 7 + t) % 100;
+                size_t align = size_t(1) << (i % 7);
+                auto p = static_cast<uint8_t*>(arena.allocate(bytes, align));
+                assert(reinterpret_cast<uintptr_t>(p) % align == 0);
+                std::fill(p, p + bytes, static_cast<uint8_t>(t + 1));
+                blocks[t].push_back({p, bytes});
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    // 8000 blocks of up to 100 bytes do not fit into 64K, so some came from upstream.
+    assert(arena.overflow_count() > 0);
+    std::vector<Block> all;
+    for (size_t t = 0; t < threads; ++t) {
+        for (const Block& b : blocks[t]) {
+            assert(std::all_of(b.p, b.p + b.bytes, [t](uint8_t x) {
+                return x == t + 1;
+            }));
+            all.push_back(b);
+        }
+    }
+    std::sort(all.begin(), all.end(), [](const Block& a, const Block& b) {
+        return std::less<>()(a.p, b.p);
+    });
+    for (size_t i = 1; i < all.size(); ++i) {
+        assert(all[i - 1].p + all[i - 1].bytes <= all[i].p);
+    }
+}
+
+// Another thread frees blocks the owner handed out, while the owner keeps allocating and
+// freeing some blocks itself. Every handed-out block must come back, and no block may be
+// handed out twice while live.
+void test_cross_thread_free() {
+    auto parent = std::make_unique<ConcurrentStorage<1 << 20>>();
+    ThreadArena arena(*parent, 4096);
+    constexpr size_t handed = 5000;
+    std::vector<void*> remote_blocks;
+    for (size_t i = 0; i < handed; ++i) {
+        remote_blocks.push_back(arena.allocate(24, 8));
+    }
+    std::vector<void*> sorted = remote_blocks;
+    std::sort(sorted.begin(), sorted.end(), std::less<>());
+    std::atomic<bool> done{false};
+    std::thread freer([&arena, &remote_blocks, &done] {
+        for (void* p : remote_blocks) {
+            arena.deallocate(p, 24, 8);
+        }
+        done.store(true, std::memory_order_release);
+    });
+    std::vector<void*> live;
+    size_t reused = 0;
+    auto take = [&](size_t i) {
+        void* p = arena.allocate(24, 8);
+        if (std::binary_search(sorted.begin(), sorted.end(), p, std::less<>())) {
+            ++reused;
+        }
+        // Every third block goes straight back to the owner's own free list.
+        if (i % 3 == 0) {
+            arena.deallocate(p, 24, 8);
+        } else {
+            live.push_back(p);
+        }
+    };
+    size_t i = 0;
+    while (!done.load(std::memory_order_acquire)) {
+        take(i++);
+    }
+    freer.join();
+    while (reused < handed) {
+        take(i++);
+        assert(i < 100 * handed);
+    }
+    std::sort(live.begin(), live.end(), std::less<>());
+    assert(std::adjacent_find(live.begin(), live.end()) == live.end());
+}
+
+void test_parallel_lists() {
+    ConcurrentStorage<1 << 16> parent;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> failures{0};
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&parent, &failures, t] {
+            ThreadArena arena(parent, 4096);
+            for (int round = 0; round < 20; ++round) {
+                List<size_t, std::pmr::polymorphic_allocator<size_t>> lst(&arena);
+                for (size_t i = 0; i < 1000; ++i) {
+                    lst.push_back(t * 1000 + i);
+                }
+                size_t expected = t * 1000;
+                for (size_t x : lst) {
+                    failures += x != expected++;
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    assert(failures == 0);
+}
+
+int main() {
+    test_shared_allocation();
+    test_cross_thread_free();
+    test_parallel_lists();
+}
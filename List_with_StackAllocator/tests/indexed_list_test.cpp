@@ -0,0 +1,190 @@
+// IndexedList against a sorted std::vector: random inserts (equal keys keep their insertion
+// order) and erases, lower_bound, upper_bound and find by a key of another type, nth and
+// index_of, then copies, moves and swaps. An allocator that refuses the index's lane
+// entries leaves a copy with a stale index: the list is intact, lookups still work, and the
+// index is rebuilt once lanes can be allocated again.
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <new>
+#include <random>
+#include <vector>
+#include "../indexed_list.h"
+
+struct Item {
+    int key;
+    int seq;
+    bool operator==(const Item&) const = default;
+};
+
+// Orders by key only, and compares items with bare keys.
+struct ByKey {
+    using is_transparent = void;
+    bool operator()(const Item& a, const Item& b) const {
+        return a.key < b.key;
+    }
+    bool operator()(const Item& a, int key) const {
+        return a.key < key;
+    }
+    bool operator()(int key, const Item& b) const {
+        return key < b.key;
+    }
+};
+
+bool fail_lanes = false;
+
+// Lane entries are the only allocations of four words: a list position, two links and a
+// width. List nodes of Item and the slab bookkeeping have other sizes.
+template <typename T>
+struct LaneFailingAllocator {
+    using value_type = T;
+    LaneFailingAllocator() = default;
+    template <typename U>
+    LaneFailingAllocator(const LaneFailingAllocator<U>&) {}
+    T* allocate(size_t n) {
+        if (fail_lanes && sizeof(T) == 4 * sizeof(void*)) {
+            throw std::bad_alloc();
+        }
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, size_t n) {
+        std::allocator<T>().deallocate(p, n);
+    }
+    bool operator==(const LaneFailingAllocator&) const {
+        return true;
+    }
+};
+
+using Index = IndexedList<Item, ByKey, LaneFailingAllocator<Item>>;
+
+void check_equal(const Index& l, const std::vector<Item>& r) {
+    assert(l.size() == r.size());
+    assert(std::equal(l.begin(), l.end(), r.begin(), r.end()));
+    for (size_t k = 0; k < r.size(); k += 1 + r.size() / 50) {
+        auto it = l.nth(k);
+        assert(*it == r[k]);
+        assert(l.index_of(it) == k);
+    }
+    assert(l.nth(r.size()) == l.end());
+    assert(l.index_of(l.end()) == r.size());
+}
+
+void check_lookups(const Index& l, const std::vector<Item>& r, int key) {
+    size_t lower = std::lower_bound(r.begin(), r.end(), key, ByKey()) - r.begin();
+    size_t upper = std::upper_bound(r.begin(), r.end(), key, ByKey()) - r.begin();
+    assert(l.index_of(l.lower_bound(key)) == lower);
+    assert(l.index_of(l.upper_bound(key)) == upper);
+    auto it = l.find(key);
+    if (lower == upper) {
+        assert(it == l.end());
+    } else {
+        assert(*it == r[lower]);
+    }
+}
+
+void test_random_ops() {
+    std::mt19937 rng(17);
+    Index l;
+    std::vector<Item> r;
+    for (int i = 0; i < 30000; ++i) {
+        size_t op = rng() % 5;
+        int key = static_cast<int>(rng() % 600);
+        if (op < 2) {
+            Item item{key, i};
+            auto it = l.insert(item);
+            auto pos = std::upper_bound(r.begin(), r.end(), key, ByKey());
+            assert(l.index_of(it) == static_cast<size_t>(pos - r.begin()));
+            r.insert(pos, item);
+        } else if (op == 2 && !r.empty()) {
+            size_t k = rng() % r.size();
+            auto next = l.erase(l.nth(k));
+            r.erase(r.begin() + k);
+            assert(l.index_of(next) == k);
+        } else if (op == 3) {
+            check_lookups(l, r, key);
+        } else if (!r.empty()) {
+            size_t k = rng() % r.size();
+            assert(*l.nth(k) == r[k] && l.index_of(l.nth(k)) == k);
+        }
+        if (i % 1000 == 0) {
+            check_equal(l, r);
+        }
+    }
+    check_equal(l, r);
+    check_lookups(l, r, -1);
+    check_lookups(l, r, 1000);
+}
+
+void test_copy_move_swap() {
+    std::mt19937 rng(4);
+    Index a;
+    std::vector<Item> ra;
+    for (int i = 0; i < 3000; ++i) {
+        Item item{static_cast<int>(rng() % 100), i};
+        a.insert(item);
+        ra.insert(std::upper_bound(ra.begin(), ra.end(), item, ByKey()), item);
+    }
+    Index b(a);
+    check_equal(b, ra);
+    b.erase(b.begin());
+    check_equal(a, ra);
+
+    Index c;
+    c.insert(Item{5, 0});
+    c = a;
+    check_equal(c, ra);
+    Index d(std::move(c));
+    check_equal(d, ra);
+    check_equal(c, {});
+    c.insert(Item{1, 1});
+    check_equal(c, {Item{1, 1}});
+
+    std::vector<Item> rb(ra.begin() + 1, ra.end());
+    swap(b, c);
+    check_equal(b, {Item{1, 1}});
+    check_equal(c, rb);
+    b = std::move(c);
+    check_equal(b, rb);
+    b.insert(Item{50, -1});
+    rb.insert(std::upper_bound(rb.begin(), rb.end(), 50, ByKey()), Item{50, -1});
+    check_equal(b, rb);
+    b.clear();
+    check_equal(b, {});
+}
+
+void test_stale_index() {
+    Index a;
+    std::vector<Item> r;
+    for (int i = 0; i < 2000; ++i) {
+        Item item{(i * 7919) % 2000, i};
+        a.insert(item);
+        r.insert(std::upper_bound(r.begin(), r.end(), item, ByKey()), item);
+    }
+    fail_lanes = true;
+    Index b(a);
+    Index c;
+    c = a;
+    check_equal(b, r);
+    check_equal(c, r);
+    for (int key = 0; key < 2000; key += 37) {
+        check_lookups(b, r, key);
+    }
+    // Erasing tries to rebuild the index first and still works when that fails.
+    b.erase(b.find(5));
+    r.erase(r.begin() + 5);
+    check_equal(b, r);
+    assert(b.find(5) == b.end());
+    fail_lanes = false;
+    b.insert(Item{5, -1});
+    r.insert(r.begin() + 5, Item{5, -1});
+    check_equal(b, r);
+    for (int key = 0; key < 2000; key += 37) {
+        check_lookups(b, r, key);
+    }
+}
+
+int main() {
+    test_random_ops();
+    test_copy_move_swap();
+    test_stale_index();
+}
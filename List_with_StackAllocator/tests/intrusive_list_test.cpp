@@ -0,0 +1,157 @@
+// IntrusiveList linking objects it does not own: pushes, inserts and erases by iterator and
+// by object compared with a std::list of ids, iterator_to, one object in two lists at once
+// through two hooks, and moving a list, which hands its objects over without touching them.
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <list>
+#include <random>
+#include <vector>
+#include "../intrusive_list.h"
+
+struct Event {
+    int id = 0;
+    ListHook by_time;
+    double weight = 0;
+    ListHook by_owner;
+};
+
+using TimeList = IntrusiveList<Event, &Event::by_time>;
+using OwnerList = IntrusiveList<Event, &Event::by_owner>;
+
+template <typename L>
+void check_equal(const L& l, const std::list<int>& r) {
+    assert(l.size() == r.size() && l.empty() == r.empty());
+    auto it = r.begin();
+    for (const Event& e : l) {
+        assert(e.id == *it++);
+    }
+    auto rit = r.rbegin();
+    for (auto i = l.rbegin(); i != l.rend(); ++i) {
+        assert(i->id == *rit++);
+    }
+    if (!r.empty()) {
+        assert(l.front().id == r.front() && l.back().id == r.back());
+    }
+}
+
+void test_random_ops() {
+    std::vector<Event> events(500);
+    for (size_t i = 0; i < events.size(); ++i) {
+        events[i].id = static_cast<int>(i);
+    }
+    std::mt19937 rng(11);
+    TimeList l;
+    std::list<int> r;
+    for (int step = 0; step < 20000; ++step) {
+        Event& e = events[rng() % events.size()];
+        size_t op = rng() % 6;
+        if (e.by_time.is_linked()) {
+            if (op < 3) {
+                l.erase(e);
+                r.remove(e.id);
+            } else if (op == 3) {
+                auto it = l.erase(l.iterator_to(e));
+                auto rit = r.erase(std::find(r.begin(), r.end(), e.id));
+                assert((it == l.end()) == (rit == r.end()));
+                assert(it == l.end() || it->id == *rit);
+            } else if (op == 4) {
+                assert(l.iterator_to(e)->id == e.id);
+                assert(&*l.iterator_to(e) == &e);
+            } else if (!r.empty()) {
+                if (rng() % 2) {
+                    r.pop_front();
+                    l.pop_front();
+                } else {
+                    r.pop_back();
+                    l.pop_back();
+                }
+            }
+        } else {
+            if (op < 2) {
+                l.push_back(e);
+                r.push_back(e.id);
+            } else if (op < 4) {
+                l.push_front(e);
+                r.push_front(e.id);
+            } else {
+                size_t pos = r.empty() ? 0 : rng() % r.size();
+                auto it = l.insert(std::next(l.cbegin(), pos), e);
+                r.insert(std::next(r.begin(), pos), e.id);
+                assert(&*it == &e);
+            }
+        }
+        if (step % 100 == 0) {
+            check_equal(l, r);
+        }
+    }
+    check_equal(l, r);
+    l.clear();
+    for (const Event& e : events) {
+        assert(!e.by_time.is_linked());
+    }
+}
+
+void test_two_hooks() {
+    std::vector<Event> events(10);
+    TimeList by_time;
+    OwnerList by_owner;
+    for (int i = 0; i < 10; ++i) {
+        events[i].id = i;
+        events[i].weight = i * 0.5;
+        by_time.push_back(events[i]);
+        by_owner.push_front(events[i]);
+    }
+    // Unlinking through one hook leaves the other list alone.
+    by_time.erase(events[3]);
+    by_owner.erase(events[7]);
+    assert(!events[3].by_time.is_linked() && events[3].by_owner.is_linked());
+    assert(events[7].by_time.is_linked() && !events[7].by_owner.is_linked());
+    check_equal(by_time, {0, 1, 2, 4, 5, 6, 7, 8, 9});
+    check_equal(by_owner, {9, 8, 6, 5, 4, 3, 2, 1, 0});
+    assert(&*by_owner.iterator_to(events[5]) == &events[5]);
+    assert(by_owner.iterator_to(events[5])->weight == 2.5);
+    // A copied object is not linked anywhere, the original keeps its place.
+    Event copy = events[4];
+    assert(!copy.by_time.is_linked() && !copy.by_owner.is_linked());
+    copy = events[6];
+    assert(!copy.by_time.is_linked() && events[6].by_time.is_linked());
+    by_time.clear();
+    by_owner.clear();
+}
+
+void test_move() {
+    std::vector<Event> events(6);
+    TimeList l;
+    for (int i = 0; i < 6; ++i) {
+        events[i].id = i;
+        l.push_back(events[i]);
+    }
+    TimeList moved(std::move(l));
+    check_equal(l, {});
+    check_equal(moved, {0, 1, 2, 3, 4, 5});
+    // Moving into a non-empty list unlinks what it held before.
+    TimeList other;
+    Event extra;
+    extra.id = 10;
+    other.push_back(extra);
+    other = std::move(moved);
+    assert(!extra.by_time.is_linked());
+    check_equal(moved, {});
+    check_equal(other, {0, 1, 2, 3, 4, 5});
+    other.erase(events[0]);
+    other.push_back(events[0]);
+    check_equal(other, {1, 2, 3, 4, 5, 0});
+    TimeList empty;
+    other = std::move(empty);
+    check_equal(other, {});
+    for (const Event& e : events) {
+        assert(!e.by_time.is_linked());
+    }
+}
+
+int main() {
+    test_random_ops();
+    test_two_hooks();
+    test_move();
+}
@@ -0,0 +1,200 @@
+// Memory held by List slabs, counted through an allocator: trimming a bulk-built list gives
+// its empty slabs back and later insertions reuse the freed nodes, nothing leaks when a
+// bulk copy throws halfway, and random splices and merges between lists that mix slab and
+// single nodes match std::list and end with every allocation returned. A comparator that
+// throws in the middle of sort leaves every element in a well-linked list.
+#include <algorithm>
+#include <cassert>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <random>
+#include <vector>
+#include "../list.h"
+
+size_t live_allocations = 0;
+size_t live_bytes = 0;
+
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+    CountingAllocator() = default;
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&) {}
+    T* allocate(size_t n) {
+        ++live_allocations;
+        live_bytes += n * sizeof(T);
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* p, size_t n) {
+        --live_allocations;
+        live_bytes -= n * sizeof(T);
+        std::allocator<T>().deallocate(p, n);
+    }
+    bool operator==(const CountingAllocator&) const {
+        return true;
+    }
+};
+
+using CountedList = List<int, CountingAllocator<int>>;
+
+struct ThrowingCopy {
+    static int copies_left;
+    int v;
+    ThrowingCopy(int v): v(v) {}
+    ThrowingCopy(const ThrowingCopy& other): v(other.v) {
+        if (--copies_left == 0) throw 1;
+    }
+};
+int ThrowingCopy::copies_left = 0;
+
+void check_equal(const CountedList& l, const std::list<int>& r) {
+    assert(l.size() == r.size());
+    auto it = r.begin();
+    for (int x : l) {
+        assert(x == *it++);
+    }
+}
+
+void test_trim_and_reuse() {
+    {
+        CountedList l(100000, 1);
+        size_t full = live_bytes;
+        auto it = std::next(l.begin());
+        while (it != l.end()) {
+            it = l.erase(it);
+        }
+        assert(live_bytes < full / 20);
+        size_t allocations = live_allocations;
+        for (int i = 0; i < 1000; ++i) {
+            l.push_back(i);
+        }
+        assert(live_allocations == allocations);
+    }
+    assert(live_allocations == 0);
+}
+
+void test_throwing_copy() {
+    {
+        List<ThrowingCopy, CountingAllocator<ThrowingCopy>> src;
+        for (int i = 0; i < 10000; ++i) {
+            src.push_back(ThrowingCopy(i));
+        }
+        size_t allocations = live_allocations;
+        ThrowingCopy::copies_left = 5000;
+        bool thrown = false;
+        try {
+            List<ThrowingCopy, CountingAllocator<ThrowingCopy>> copy(src);
+        } catch (int) {
+            thrown = true;
+        }
+        assert(thrown && live_allocations == allocations);
+        ThrowingCopy::copies_left = 0;
+    }
+    assert(live_allocations == 0);
+}
+
+void test_random_transfers() {
+    {
+        std::mt19937 rng(3);
+        CountedList lists[2] = {CountedList(5000, 1), CountedList(7000, 2)};
+        std::list<int> refs[2] = {std::list<int>(5000, 1), std::list<int>(7000, 2)};
+        for (int i = 0; i < 20000; ++i) {
+            size_t k = rng() % 2;
+            CountedList& l = lists[k];
+            CountedList& other = lists[1 - k];
+            std::list<int>& r = refs[k];
+            std::list<int>& other_r = refs[1 - k];
+            size_t op = rng() % 8;
+            if (op == 0) {
+                l.push_back(i);
+                r.push_back(i);
+            } else if (op == 1 && !r.empty()) {
+                l.pop_front();
+                r.pop_front();
+            } else if (op == 2 && !other_r.empty()) {
+                size_t pos = rng() % other_r.size();
+                l.splice(l.begin(), other, std::next(other.begin(), pos));
+                r.splice(r.begin(), other_r, std::next(other_r.begin(), pos));
+            } else if (op == 3 && other_r.size() > 2) {
+                size_t pos = rng() % (other_r.size() / 2);
+                l.splice(l.end(), other, std::next(other.begin(), pos), std::next(other.begin(), 2 * pos));
+                r.splice(r.end(), other_r, std::next(other_r.begin(), pos), std::next(other_r.begin(), 2 * pos));
+            } else if (op == 4 && !r.empty()) {
+                size_t pos = rng() % r.size();
+                l.erase(std::next(l.begin(), pos));
+                r.erase(std::next(r.begin(), pos));
+            } else if (op == 5 && rng() % 100 == 0) {
+                CountedList fresh(300, i);
+                l.splice(l.begin(), fresh);
+                r.splice(r.begin(), std::list<int>(300, i));
+            } else if (op == 6 && rng() % 200 == 0) {
+                l.sort();
+                other.sort();
+                l.merge(other);
+                r.sort();
+                other_r.sort();
+                r.merge(other_r);
+            } else if (op == 7 && rng() % 100 == 0) {
+                l.splice(l.end(), other);
+                r.splice(r.end(), other_r);
+            }
+            if (i % 500 == 0) {
+                check_equal(lists[0], refs[0]);
+                check_equal(lists[1], refs[1]);
+            }
+        }
+        check_equal(lists[0], refs[0]);
+        check_equal(lists[1], refs[1]);
+        CountedList moved(std::move(lists[0]));
+        lists[0] = CountedList(10, 3);
+        lists[0].swap(lists[1]);
+        lists[1] = moved;
+    }
+    assert(live_allocations == 0);
+}
+
+void test_throwing_sort() {
+    {
+        std::mt19937 rng(9);
+        for (size_t n : {2, 3, 20, 257}) {
+            for (size_t fail = 1; fail < 4 * n; fail += 1 + n / 16) {
+                CountedList l;
+                std::vector<int> values;
+                for (size_t i = 0; i < n; ++i) {
+                    values.push_back(static_cast<int>(rng() % (n / 2 + 1)));
+                    l.push_back(values.back());
+                }
+                size_t calls = 0;
+                try {
+                    l.sort([&calls, fail](int a, int b) {
+                        if (++calls == fail) throw 1;
+                        return a < b;
+                    });
+                } catch (int) {
+                }
+                // Both directions have to see the same elements, then the list is usable again.
+                assert(l.size() == n);
+                std::vector<int> forward(l.begin(), l.end());
+                std::vector<int> backward(l.rbegin(), l.rend());
+                std::reverse(backward.begin(), backward.end());
+                assert(forward == backward);
+                std::sort(forward.begin(), forward.end());
+                std::sort(values.begin(), values.end());
+                assert(forward == values);
+                l.sort();
+                assert(std::equal(l.begin(), l.end(), values.begin(), values.end()));
+                l.push_front(-1);
+                l.pop_back();
+            }
+        }
+    }
+    assert(live_allocations == 0);
+}
+
+int main() {
+    test_trim_and_reuse();
+    test_throwing_copy();
+    test_random_transfers();
+    test_throwing_sort();
+}
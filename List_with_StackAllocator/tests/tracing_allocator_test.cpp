@@ -0,0 +1,149 @@
+// TracingAllocator counting the allocations of one allocator and of a List: counts, bytes,
+// peak and the size histogram, failed allocations, the checks for bad and mismatched frees
+// and for writes past the end, and the JSON report. The disabled adapter is empty, forwards
+// to Inner and leaves its trace untouched.
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include "../list.h"
+#include "../tracing_allocator.h"
+
+using Traced = TracingAllocator<std::allocator<int>>;
+using Untraced = TracingAllocator<std::allocator<int>, false>;
+
+size_t histogram_total(const AllocationTrace& trace) {
+    size_t total = 0;
+    for (size_t count : trace.histogram) {
+        total += count;
+    }
+    return total;
+}
+
+void test_counts() {
+    AllocationTrace trace("ints");
+    Traced a(trace);
+    int* p = a.allocate(10);
+    int* q = a.allocate(100);
+    assert(trace.allocations == 2 && trace.live_bytes == 440);
+    a.deallocate(p, 10);
+    int* r = a.allocate(1);
+    assert(trace.peak_bytes == 440 && trace.live_bytes == 404);
+    // 40 bytes fall into [32, 64), 400 into [256, 512), 4 into [4, 8).
+    assert(trace.histogram[6] == 1 && trace.histogram[9] == 1 && trace.histogram[3] == 1);
+    assert(histogram_total(trace) == trace.allocations);
+    a.deallocate(q, 100);
+    a.deallocate(r, 1);
+    assert(trace.deallocations == 3 && trace.live_bytes == 0);
+    assert(trace.bytes_allocated == 444 && trace.bytes_deallocated == 444);
+
+    bool thrown = false;
+    try {
+        a.allocate(SIZE_MAX / 2);
+    } catch (const std::bad_alloc&) {
+        thrown = true;
+    }
+    assert(thrown && trace.failed_allocations == 1 && trace.allocations == 3);
+
+    // An adapter without a trace only forwards.
+    Traced plain;
+    plain.deallocate(plain.allocate(5), 5);
+    assert(trace.allocations == 3);
+}
+
+// Rebound copies in the list report its nodes to the same trace.
+void test_list() {
+    AllocationTrace trace("list");
+    {
+        List<int, Traced> l(trace);
+        for (int i = 0; i < 1000; ++i) {
+            l.push_back(i);
+        }
+        List<int, Traced> copy(l);
+        assert(copy.size() == 1000);
+        assert(trace.live_bytes > 0 && trace.peak_bytes >= trace.live_bytes);
+    }
+    assert(trace.allocations > 0 && trace.allocations == trace.deallocations);
+    assert(trace.live_bytes == 0 && trace.bytes_allocated == trace.bytes_deallocated);
+    assert(histogram_total(trace) == trace.allocations);
+}
+
+void test_checks() {
+    AllocationTrace trace("checked", true);
+    Traced a(trace);
+    int* p = a.allocate(4);
+    a.deallocate(p, 4);
+    a.deallocate(p, 4);
+    assert(trace.bad_frees == 1 && trace.deallocations == 1);
+    int x = 0;
+    a.deallocate(&x, 1);
+    assert(trace.bad_frees == 2);
+
+    // The size recorded at allocation is the one released.
+    p = a.allocate(8);
+    a.deallocate(p, 3);
+    assert(trace.size_mismatches == 1 && trace.live_bytes == 0);
+
+    p = a.allocate(2);
+    p[2] = 7;
+    a.deallocate(p, 2);
+    assert(trace.overflows == 1);
+
+    int* leaked = a.allocate(3);
+    assert(trace.live.size() == 1);
+    std::string json = trace.to_json();
+    assert(json.find("\"name\": \"checked\"") != std::string::npos);
+    assert(json.find("\"allocations\": 4") != std::string::npos);
+    assert(json.find("\"bad_frees\": 2") != std::string::npos);
+    assert(json.find("\"size_mismatches\": 1") != std::string::npos);
+    assert(json.find("\"overflows\": 1") != std::string::npos);
+    assert(json.find("\"leaked_allocations\": 1") != std::string::npos);
+    a.deallocate(leaked, 3);
+}
+
+void test_json() {
+    AllocationTrace trace("a \"quoted\\name");
+    Traced a(trace);
+    a.deallocate(a.allocate(1), 1);
+    a.deallocate(a.allocate(3), 3);
+    std::string json = trace.to_json();
+    assert(json.front() == '{' && json.back() == '}');
+    assert(json.find("\"name\": \"a \\\"quoted\\\\name\"") != std::string::npos);
+    assert(json.find("\"histogram\": {\"4\": 1, \"8\": 1}") != std::string::npos);
+    assert(json.find("\"peak_bytes\": 12") != std::string::npos);
+    // Without check there is nothing to report about frees.
+    assert(json.find("bad_frees") == std::string::npos);
+}
+
+void test_disabled() {
+    static_assert(std::is_empty_v<Untraced>);
+    static_assert(sizeof(Untraced) == sizeof(std::allocator<int>));
+    static_assert(Untraced::is_always_equal::value);
+    static_assert(std::is_same_v<std::allocator_traits<Untraced>::rebind_alloc<double>,
+                                 TracingAllocator<std::allocator<double>, false>>);
+    AllocationTrace trace("disabled", true);
+    {
+        Untraced a(trace);
+        assert(a.get_trace() == nullptr);
+        a.deallocate(a.allocate(10), 10);
+        List<int, Untraced> l(trace);
+        for (int i = 0; i < 100; ++i) {
+            l.push_back(i);
+        }
+        List<int, Untraced> copy(l);
+        assert(copy.size() == 100);
+        assert(a == Untraced() && l.get_allocator() == Untraced());
+    }
+    assert(trace.allocations == 0 && trace.deallocations == 0 && trace.live.empty());
+    assert(histogram_total(trace) == 0);
+}
+
+int main() {
+    test_counts();
+    test_list();
+    test_checks();
+    test_json();
+    test_disabled();
+}
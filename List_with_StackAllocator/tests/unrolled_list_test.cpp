@@ -0,0 +1,107 @@
+// UnrolledList against std::list: random pushes, pops, inserts and erases at random
+// positions with small node sizes, so that splits, merges and borrows happen all the time,
+// then the cases where the inserted value is an element that a split moves.
+#include <cassert>
+#include <iterator>
+#include <list>
+#include <random>
+#include <string>
+#include "../unrolled_list.h"
+
+template <typename L, typename R>
+void check_equal(const L& l, const R& r) {
+    assert(l.size() == r.size());
+    auto it = r.begin();
+    for (const auto& x : l) {
+        assert(x == *it++);
+    }
+    auto rit = r.rbegin();
+    for (auto i = l.rbegin(); i != l.rend(); ++i) {
+        assert(*i == *rit++);
+    }
+}
+
+template <size_t K>
+void test_random_ops() {
+    std::mt19937 rng(K);
+    UnrolledList<std::string, K> l;
+    std::list<std::string> r;
+    for (int i = 0; i < 20000; ++i) {
+        std::string v = std::to_string(i);
+        size_t op = rng() % 8;
+        if (op == 0) {
+            l.push_back(v);
+            r.push_back(v);
+        } else if (op == 1) {
+            l.push_front(v);
+            r.push_front(v);
+        } else if (op == 2 && !r.empty()) {
+            l.pop_back();
+            r.pop_back();
+        } else if (op == 3 && !r.empty()) {
+            l.pop_front();
+            r.pop_front();
+        } else if (op < 6) {
+            size_t pos = rng() % (r.size() + 1);
+            auto x = l.insert(std::next(l.begin(), pos), v);
+            auto y = r.insert(std::next(r.begin(), pos), v);
+            assert(*x == *y);
+            assert(static_cast<size_t>(std::distance(l.begin(), x)) == pos);
+        } else if (!r.empty()) {
+            size_t pos = rng() % r.size();
+            auto x = l.erase(std::next(l.begin(), pos));
+            auto y = r.erase(std::next(r.begin(), pos));
+            assert((x == l.end()) == (y == r.end()));
+            if (y != r.end()) {
+                assert(*x == *y);
+            }
+        }
+        if (i % 101 == 0) {
+            check_equal(l, r);
+        }
+        // Shrink now and then so that long runs of erases empty and merge nodes.
+        if (r.size() > 200 && rng() % 4 == 0) {
+            while (r.size() > 5) {
+                size_t pos = rng() % r.size();
+                l.erase(std::next(l.begin(), pos));
+                r.erase(std::next(r.begin(), pos));
+            }
+        }
+    }
+    check_equal(l, r);
+
+    UnrolledList<std::string, K> copy = l;
+    check_equal(copy, r);
+    UnrolledList<std::string, K> moved = std::move(copy);
+    check_equal(moved, r);
+    assert(copy.size() == 0 && copy.begin() == copy.end());
+}
+
+// The inserted value lives in the full node that the insertion splits.
+void test_insert_own_element() {
+    for (size_t pos = 1; pos < 4; ++pos) {
+        for (size_t src = 0; src < 4; ++src) {
+            UnrolledList<std::string, 4> l;
+            std::list<std::string> r;
+            for (int i = 0; i < 4; ++i) {
+                std::string v(20, static_cast<char>('a' + i));
+                l.push_back(v);
+                r.push_back(v);
+            }
+            l.insert(std::next(l.begin(), pos), *std::next(l.begin(), src));
+            r.insert(std::next(r.begin(), pos), *std::next(r.begin(), src));
+            check_equal(l, r);
+            l.emplace(std::next(l.begin(), 1), *std::prev(l.end()));
+            r.emplace(std::next(r.begin(), 1), *std::prev(r.end()));
+            check_equal(l, r);
+        }
+    }
+}
+
+int main() {
+    test_random_ops<2>();
+    test_random_ops<3>();
+    test_random_ops<4>();
+    test_random_ops<16>();
+    test_insert_own_element();
+}
@@ -0,0 +1,299 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+// Allocation statistics of one container, filled in by the TracingAllocators it uses.
+// Not synchronized: a trace must not be shared by containers used from different threads.
+//
+// With check set, every live allocation is remembered and followed by guard bytes, so that
+// deallocating a pointer twice (or one that was never allocated), deallocating with a
+// different size and writing past the end of an allocation are counted. Bad deallocations
+// are not passed on to the inner allocator.
+struct AllocationTrace {
+    // Allocation sizes in bytes: bucket k counts sizes in [2^(k-1), 2^k), bucket 0 is size 0.
+    constexpr static size_t buckets = 64;
+
+    std::string name;
+    bool check = false;
+    size_t allocations = 0;
+    size_t deallocations = 0;
+    size_t failed_allocations = 0;
+    size_t bytes_allocated = 0;
+    size_t bytes_deallocated = 0;
+    size_t live_bytes = 0;
+    size_t peak_bytes = 0;
+    size_t histogram[buckets] = {};
+    size_t bad_frees = 0;
+    size_t size_mismatches = 0;
+    size_t overflows = 0;
+    // Requested size of every live allocation, kept only with check.
+    std::unordered_map<const void*, size_t> live;
+
+    explicit AllocationTrace(std::string name = "", bool check = false): name(std::move(name)), check(check) {}
+
+    void on_allocate(size_t bytes) {
+        ++allocations;
+        bytes_allocated += bytes;
+        live_bytes += bytes;
+        peak_bytes = std::max(peak_bytes, live_bytes);
+        ++histogram[std::bit_width(bytes)];
+    }
+    void on_deallocate(size_t bytes) {
+        ++deallocations;
+        bytes_deallocated += bytes;
+        live_bytes -= bytes;
+    }
+
+    std::string to_json() const;
+};
+
+inline std::string AllocationTrace::to_json() const {
+    std::string json = "{\"name\": \"";
+    for (char c : name) {
+        if (c == '"' || c == '\\') {
+            json += '\\';
+        }
+        json += c;
+    }
+    json += "\"";
+    auto field = [&json](const char* key, size_t value) {
+        json += ", \"";
+        json += key;
+        json += "\": ";
+        json += std::to_string(value);
+    };
+    field("allocations", allocations);
+    field("deallocations", deallocations);
+    field("failed_allocations", failed_allocations);
+    field("bytes_allocated", bytes_allocated);
+    field("bytes_deallocated", bytes_deallocated);
+    field("live_bytes", live_bytes);
+    field("peak_bytes", peak_bytes);
+    // Keyed by the smallest size of the bucket, empty buckets are left out.
+    json += ", \"histogram\": {";
+    bool first = true;
+    for (size_t k = 0; k < buckets; ++k) {
+        if (histogram[k] == 0) continue;
+        json += first ? "\"" : ", \"";
+        json += std::to_string(k == 0 ? 0 : size_t(1) << (k - 1));
+        json += "\": ";
+        json += std::to_string(histogram[k]);
+        first = false;
+    }
+    json += "}";
+    if (check) {
+        field("bad_frees", bad_frees);
+        field("size_mismatches", size_mismatches);
+        field("overflows", overflows);
+        field("leaked_allocations", live.size());
+    }
+    json += "}";
+    return json;
+}
+
+// Adapter that records every allocation and deallocation of Inner in an AllocationTrace.
+// Rebound copies share the trace, so a List or Deque reports its nodes, blocks and map
+// together. Propagation and equality follow Inner; two adapters are equal only if they
+// also write to the same trace. A default-constructed adapter traces nothing.
+//
+// With Enabled false the adapter (a specialization below) holds nothing but Inner, ignores
+// the trace and only forwards. Builds that should not pay for tracing pass false from one
+// project-wide constant, so every translation unit still sees the same class:
+//
+//     constexpr bool trace_orders = true;
+//     AllocationTrace trace("orders", true);
+//     List<Order, TracingAllocator<std::allocator<Order>, trace_orders>> orders(trace);
+template <typename Inner, bool Enabled = true>
+class TracingAllocator {
+private:
+    using InnerTraits = std::allocator_traits<Inner>;
+
+    Inner inner;
+    AllocationTrace* trace = nullptr;
+
+    constexpr static size_t guard_bytes = 16;
+    constexpr static unsigned char guard_byte = 0xfd;
+
+public:
+    using value_type = typename InnerTraits::value_type;
+    using propagate_on_container_copy_assignment = typename InnerTraits::propagate_on_container_copy_assignment;
+    using propagate_on_container_move_assignment = typename InnerTraits::propagate_on_container_move_assignment;
+    using propagate_on_container_swap = typename InnerTraits::propagate_on_container_swap;
+    using is_always_equal = std::false_type;
+
+private:
+    // Elements appended to every checked allocation to hold the guard bytes.
+    constexpr static size_t guard = (guard_bytes + sizeof(value_type) - 1) / sizeof(value_type);
+
+public:
+    template <typename U, bool E> friend class TracingAllocator;
+    TracingAllocator() = default;
+    TracingAllocator(const Inner& inner): inner(inner) {}
+    TracingAllocator(AllocationTrace& trace, const Inner& inner = Inner()):
+            inner(inner), trace(&trace) {}
+    template <typename U>
+    TracingAllocator(const TracingAllocator<U, true>& other): inner(other.inner), trace(other.trace) {}
+
+    value_type* allocate(size_t n);
+    void deallocate(value_type* p, size_t n);
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        InnerTraits::construct(inner, p, std::forward<Args>(args)...);
+    }
+    template <typename U>
+    void destroy(U* p) {
+        InnerTraits::destroy(inner, p);
+    }
+
+    TracingAllocator select_on_container_copy_construction() const {
+        TracingAllocator copy(InnerTraits::select_on_container_copy_construction(inner));
+        copy.trace = trace;
+        return copy;
+    }
+
+    const Inner& inner_allocator() const {
+        return inner;
+    }
+    AllocationTrace* get_trace() const {
+        return trace;
+    }
+
+    template <typename U>
+    struct rebind {
+        using other = TracingAllocator<typename InnerTraits::template rebind_alloc<U>, true>;
+    };
+};
+
+template <typename Inner>
+class TracingAllocator<Inner, false> {
+private:
+    using InnerTraits = std::allocator_traits<Inner>;
+
+    [[no_unique_address]] Inner inner;
+
+public:
+    using value_type = typename InnerTraits::value_type;
+    using propagate_on_container_copy_assignment = typename InnerTraits::propagate_on_container_copy_assignment;
+    using propagate_on_container_move_assignment = typename InnerTraits::propagate_on_container_move_assignment;
+    using propagate_on_container_swap = typename InnerTraits::propagate_on_container_swap;
+    using is_always_equal = typename InnerTraits::is_always_equal;
+
+    template <typename U, bool E> friend class TracingAllocator;
+    TracingAllocator() = default;
+    TracingAllocator(const Inner& inner): inner(inner) {}
+    TracingAllocator(AllocationTrace&, const Inner& inner = Inner()): inner(inner) {}
+    template <typename U>
+    TracingAllocator(const TracingAllocator<U, false>& other): inner(other.inner) {}
+
+    value_type* allocate(size_t n) {
+        return InnerTraits::allocate(inner, n);
+    }
+    void deallocate(value_type* p, size_t n) {
+        InnerTraits::deallocate(inner, p, n);
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        InnerTraits::construct(inner, p, std::forward<Args>(args)...);
+    }
+    template <typename U>
+    void destroy(U* p) {
+        InnerTraits::destroy(inner, p);
+    }
+
+    TracingAllocator select_on_container_copy_construction() const {
+        return TracingAllocator(InnerTraits::select_on_container_copy_construction(inner));
+    }
+
+    const Inner& inner_allocator() const {
+        return inner;
+    }
+    AllocationTrace* get_trace() const {
+        return nullptr;
+    }
+
+    template <typename U>
+    struct rebind {
+        using other = TracingAllocator<typename InnerTraits::template rebind_alloc<U>, false>;
+    };
+};
+
+template <typename A1, typename A2, bool E>
+bool operator==(const TracingAllocator<A1, E>& a1, const TracingAllocator<A2, E>& a2) {
+    return a1.get_trace() == a2.get_trace() && a1.inner_allocator() == a2.inner_allocator();
+}
+
+template <typename A1, typename A2, bool E>
+bool operator!=(const TracingAllocator<A1, E>& a1, const TracingAllocator<A2, E>& a2) {
+    return !(a1 == a2);
+}
+
+template <typename Inner, bool Enabled>
+auto TracingAllocator<Inner, Enabled>::allocate(size_t n) -> value_type* {
+    if (trace == nullptr) {
+        return InnerTraits::allocate(inner, n);
+    }
+    size_t bytes = n * sizeof(value_type);
+    value_type* p;
+    try {
+        p = InnerTraits::allocate(inner, trace->check ? n + guard : n);
+    } catch (...) {
+        ++trace->failed_allocations;
+        throw;
+    }
+    if (trace->check) {
+        std::memset(reinterpret_cast<unsigned char*>(p) + bytes, guard_byte, guard * sizeof(value_type));
+        try {
+            trace->live.emplace(p, bytes);
+        } catch (...) {
+            InnerTraits::deallocate(inner, p, n + guard);
+            throw;
+        }
+    }
+    trace->on_allocate(bytes);
+    return p;
+}
+
+template <typename Inner, bool Enabled>
+void TracingAllocator<Inner, Enabled>::deallocate(value_type* p, size_t n) {
+    if (trace == nullptr) {
+        InnerTraits::deallocate(inner, p, n);
+        return;
+    }
+    size_t bytes = n * sizeof(value_type);
+    if (trace->check) {
+        auto it = trace->live.find(p);
+        if (it == trace->live.end()) {
+            ++trace->bad_frees;
+            return;
+        }
+        if (it->second != bytes) {
+            ++trace->size_mismatches;
+            bytes = it->second;
+            n = bytes / sizeof(value_type);
+        }
+        trace->live.erase(it);
+        auto tail = reinterpret_cast<const unsigned char*>(p) + bytes;
+        for (size_t i = 0; i < guard * sizeof(value_type); ++i) {
+            if (tail[i] != guard_byte) {
+                ++trace->overflows;
+                break;
+            }
+        }
+        trace->on_deallocate(bytes);
+        InnerTraits::deallocate(inner, p, n + guard);
+        return;
+    }
+    trace->on_deallocate(bytes);
+    InnerTraits::deallocate(inner, p, n);
+}
+
@@ -0,0 +1,478 @@
+#pragma once
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// Linked list that keeps up to K elements per node in a contiguous array, so traversal
+// touches one node per K elements instead of one per element.
+//
+// Inserting into a full node splits it into two halves. When an erase leaves a node less
+// than half full, the node is merged with a neighbour if both fit into one node, otherwise
+// it borrows an element from that neighbour. Pushing at an end whose node is full starts a
+// new node instead of splitting, so sequential push_back fills nodes completely.
+//
+// Elements move between slots and nodes, so insert and erase invalidate all iterators.
+template <typename T, size_t K = 16, typename Allocator = std::allocator<T>>
+class UnrolledList {
+    static_assert(K >= 2, "UnrolledList needs at least two elements per node");
+    private:
+        struct BaseNode {
+            BaseNode* prev = nullptr;
+            BaseNode* next = nullptr;
+        };
+        struct Node: BaseNode {
+            size_t count = 0;
+            alignas(T) uint8_t storage[K * sizeof(T)];
+            T* data() {
+                return reinterpret_cast<T*>(storage);
+            }
+        };
+        constexpr static size_t min_fill = K / 2;
+
+        size_t sz = 0;
+        // The sentinel closes the ring: an empty list's sentinel points at itself.
+        BaseNode fakeNode{&fakeNode, &fakeNode};
+
+    public:
+        using AllocTraits = std::allocator_traits<Allocator>;
+        using NodeAlloc = typename AllocTraits::template rebind_alloc<Node>;
+        using NodeTraits = std::allocator_traits<NodeAlloc>;
+
+    private:
+        Allocator alloc;
+
+        static Node* as_node(BaseNode* b) {
+            return static_cast<Node*>(b);
+        }
+
+        Node* new_node_before(BaseNode* pos) {
+            NodeAlloc node_alloc(alloc);
+            Node* node = NodeTraits::allocate(node_alloc, 1);
+            NodeTraits::construct(node_alloc, node);
+            node->prev = pos->prev;
+            node->next = pos;
+            pos->prev->next = node;
+            pos->prev = node;
+            return node;
+        }
+
+        // The node's elements have to be destroyed already.
+        void free_node(Node* node) {
+            node->prev->next = node->next;
+            node->next->prev = node->prev;
+            NodeAlloc node_alloc(alloc);
+            NodeTraits::destroy(node_alloc, node);
+            NodeTraits::deallocate(node_alloc, node, 1);
+        }
+
+        // Moves the elements [from, count) of a to the end of b. If a move throws,
+        // the elements already built in b are destroyed and a keeps all of its own.
+        void move_tail(Node* a, size_t from, Node* b) {
+            size_t b_count = b->count;
+            try {
+                for (size_t i = from; i < a->count; ++i, ++b->count) {
+                    AllocTraits::construct(alloc, b->data() + b->count, std::move(a->data()[i]));
+                }
+            } catch(...) {
+                while (b->count > b_count) {
+                    AllocTraits::destroy(alloc, b->data() + --b->count);
+                }
+                throw;
+            }
+            while (a->count > from) {
+                AllocTraits::destroy(alloc, a->data() + --a->count);
+            }
+        }
+
+        // Constructs an element at idx of a node that has room for it.
+        template <typename... Args>
+        void emplace_in(Node* node, size_t idx, Args&&... args) {
+            T* d = node->data();
+            if (idx == node->count) {
+                AllocTraits::construct(alloc, d + idx, std::forward<Args>(args)...);
+            } else {
+                T tmp(std::forward<Args>(args)...);
+                AllocTraits::construct(alloc, d + node->count, std::move(d[node->count - 1]));
+                std::move_backward(d + idx, d + node->count - 1, d + node->count);
+                d[idx] = std::move(tmp);
+            }
+            ++node->count;
+        }
+
+        void erase_in(Node* node, size_t idx) {
+            T* d = node->data();
+            std::move(d + idx + 1, d + node->count, d + idx);
+            AllocTraits::destroy(alloc, d + --node->count);
+        }
+
+        template <typename... Args>
+        std::pair<BaseNode*, size_t> insert_at(BaseNode* pos, size_t idx, Args&&... args);
+        std::pair<BaseNode*, size_t> erase_at(Node* node, size_t idx);
+
+        // Exchanges the elements, the first and last nodes are re-pointed at the other sentinel.
+        void swap_nodes(UnrolledList& other) noexcept {
+            std::swap(fakeNode, other.fakeNode);
+            std::swap(sz, other.sz);
+            for (UnrolledList* lst : {this, &other}) {
+                if (lst->sz == 0) {
+                    lst->fakeNode.prev = lst->fakeNode.next = &lst->fakeNode;
+                } else {
+                    lst->fakeNode.next->prev = &lst->fakeNode;
+                    lst->fakeNode.prev->next = &lst->fakeNode;
+                }
+            }
+        }
+
+    public:
+        UnrolledList() = default;
+        explicit UnrolledList(const Allocator& al): alloc(al) {}
+        UnrolledList(size_t n, const T& val, const Allocator& al = Allocator()): alloc(al) {
+            try {
+                for (size_t i = 0; i < n; ++i) {
+                    push_back(val);
+                }
+            } catch(...) {
+                clear();
+                throw;
+            }
+        }
+
+        UnrolledList(const UnrolledList& lst):
+                UnrolledList(lst, AllocTraits::select_on_container_copy_construction(lst.alloc)) {}
+
+        UnrolledList(const UnrolledList& lst, const Allocator& al): alloc(al) {
+            try {
+                for (const T& x : lst) {
+                    push_back(x);
+                }
+            } catch(...) {
+                clear();
+                throw;
+            }
+        }
+
+        UnrolledList(UnrolledList&& other) noexcept: alloc(std::move(other.alloc)) {
+            swap_nodes(other);
+        }
+
+        ~UnrolledList() {
+            clear();
+        }
+
+        UnrolledList& operator=(const UnrolledList& lst) {
+            if (this == &lst) return *this;
+            if constexpr (AllocTraits::propagate_on_container_copy_assignment::value) {
+                UnrolledList copy(lst, lst.alloc);
+                swap_nodes(copy);
+                std::swap(alloc, copy.alloc);
+            } else {
+                UnrolledList copy(lst, alloc);
+                swap_nodes(copy);
+            }
+            return *this;
+        }
+
+        UnrolledList& operator=(UnrolledList&& other) noexcept(AllocTraits::propagate_on_container_move_assignment::value
+                                                               || AllocTraits::is_always_equal::value) {
+            if (this == &other) return *this;
+            if constexpr (AllocTraits::propagate_on_container_move_assignment::value) {
+                clear();
+                alloc = std::move(other.alloc);
+                swap_nodes(other);
+            } else {
+                if (alloc == other.alloc) {
+                    clear();
+                    swap_nodes(other);
+                } else {
+                    UnrolledList tmp(alloc);
+                    for (T& x : other) {
+                        tmp.push_back(std::move(x));
+                    }
+                    swap_nodes(tmp);
+                }
+            }
+            return *this;
+        }
+
+        void swap(UnrolledList& other) noexcept {
+            if constexpr (AllocTraits::propagate_on_container_swap::value) {
+                std::swap(alloc, other.alloc);
+            }
+            swap_nodes(other);
+        }
+
+        friend void swap(UnrolledList& a, UnrolledList& b) noexcept {
+            a.swap(b);
+        }
+
+        Allocator get_allocator() const {
+            return alloc;
+        }
+
+        size_t size() const {
+            return sz;
+        }
+
+        void clear() {
+            while (fakeNode.next != &fakeNode) {
+                Node* node = as_node(fakeNode.next);
+                while (node->count > 0) {
+                    AllocTraits::destroy(alloc, node->data() + --node->count);
+                }
+                free_node(node);
+            }
+            sz = 0;
+        }
+
+        template <bool is_const>
+        class Iterator {
+        private:
+            BaseNode* ptr = nullptr;
+            size_t idx = 0;
+        public:
+            using difference_type = std::ptrdiff_t;
+            using value_type = T;
+            using iterator_category = std::bidirectional_iterator_tag;
+            using reference = std::conditional_t<is_const, const T&, T&>;
+            using pointer = std::conditional_t<is_const, const T*, T*>;
+
+            Iterator() = default;
+            Iterator(const BaseNode* p, size_t idx): ptr(const_cast<BaseNode*>(p)), idx(idx) {}
+            operator Iterator<true>() const {
+                return Iterator<true>(ptr, idx);
+            }
+            Iterator& operator++() {
+                if (++idx == as_node(ptr)->count) {
+                    ptr = ptr->next;
+                    idx = 0;
+                }
+                return *this;
+            }
+            Iterator& operator--() {
+                if (idx == 0) {
+                    ptr = ptr->prev;
+                    idx = as_node(ptr)->count;
+                }
+                --idx;
+                return *this;
+            }
+            Iterator operator++(int) {
+                Iterator it = *this;
+                ++(*this);
+                return it;
+            }
+            Iterator operator--(int) {
+                Iterator it = *this;
+                --(*this);
+                return it;
+            }
+            bool operator==(const Iterator& other) const {
+                return ptr == other.ptr && idx == other.idx;
+            }
+            bool operator!=(const Iterator& other) const {
+                return !(*this == other);
+            }
+            reference operator*() const {
+                return as_node(ptr)->data()[idx];
+            }
+            pointer operator->() const {
+                return as_node(ptr)->data() + idx;
+            }
+            friend class UnrolledList<T, K, Allocator>;
+        };
+
+        using const_iterator = Iterator<true>;
+        using iterator = Iterator<false>;
+        using const_reverse_iterator = std::reverse_iterator<Iterator<true>>;
+        using reverse_iterator = std::reverse_iterator<Iterator<false>>;
+
+        iterator begin() {
+            return iterator(fakeNode.next, 0);
+        }
+        const_iterator begin() const {
+            return const_iterator(fakeNode.next, 0);
+        }
+        const_iterator cbegin() const {
+            return const_iterator(fakeNode.next, 0);
+        }
+
+        iterator end() {
+            return iterator(&fakeNode, 0);
+        }
+        const_iterator end() const {
+            return const_iterator(&fakeNode, 0);
+        }
+        const_iterator cend() const {
+            return const_iterator(&fakeNode, 0);
+        }
+
+        reverse_iterator rbegin() {
+            return std::reverse_iterator(end());
+        }
+        const_reverse_iterator rbegin() const {
+            return std::reverse_iterator(cend());
+        }
+        const_reverse_iterator crbegin() const {
+            return std::reverse_iterator(cend());
+        }
+
+        reverse_iterator rend() {
+            return std::reverse_iterator(begin());
+        }
+        const_reverse_iterator rend() const {
+            return std::reverse_iterator(cbegin());
+        }
+        const_reverse_iterator crend() const {
+            return std::reverse_iterator(cbegin());
+        }
+
+        template <typename... Args>
+        iterator emplace(const_iterator it, Args&&... args) {
+            auto [node, idx] = insert_at(it.ptr, it.idx, std::forward<Args>(args)...);
+            return iterator(node, idx);
+        }
+        iterator insert(const_iterator it, const T& val) {
+            return emplace(it, val);
+        }
+        iterator insert(const_iterator it, T&& val) {
+            return emplace(it, std::move(val));
+        }
+
+        template <typename... Args>
+        T& emplace_back(Args&&... args) {
+            auto [node, idx] = insert_at(&fakeNode, 0, std::forward<Args>(args)...);
+            return as_node(node)->data()[idx];
+        }
+        template <typename... Args>
+        T& emplace_front(Args&&... args) {
+            auto [node, idx] = insert_at(fakeNode.next, 0, std::forward<Args>(args)...);
+            return as_node(node)->data()[idx];
+        }
+        void push_back(const T& val) {
+            emplace_back(val);
+        }
+        void push_back(T&& val) {
+            emplace_back(std::move(val));
+        }
+        void push_front(const T& val) {
+            emplace_front(val);
+        }
+        void push_front(T&& val) {
+            emplace_front(std::move(val));
+        }
+
+        iterator erase(const_iterator it) {
+            auto [node, idx] = erase_at(as_node(it.ptr), it.idx);
+            return iterator(node, idx);
+        }
+        void pop_back() {
+            Node* last = as_node(fakeNode.prev);
+            erase_at(last, last->count - 1);
+        }
+        void pop_front() {
+            erase_at(as_node(fakeNode.next), 0);
+        }
+};
+
+template <typename T, size_t K, typename Allocator>
+template <typename... Args>
+std::pair<typename UnrolledList<T, K, Allocator>::BaseNode*, size_t>
+UnrolledList<T, K, Allocator>::insert_at(BaseNode* pos, size_t idx, Args&&... args) {
+    Node* node;
+    bool fresh = false;
+    if (pos == &fakeNode) {
+        if (sz > 0 && as_node(fakeNode.prev)->count < K) {
+            node = as_node(fakeNode.prev);
+            idx = node->count;
+        } else {
+            node = new_node_before(&fakeNode);
+            fresh = true;
+            idx = 0;
+        }
+    } else if (as_node(pos)->count < K) {
+        node = as_node(pos);
+    } else if (idx == 0 && pos->prev != &fakeNode && as_node(pos->prev)->count < K) {
+        node = as_node(pos->prev);
+        idx = node->count;
+    } else if (idx == 0 && pos->prev == &fakeNode) {
+        node = new_node_before(pos);
+        fresh = true;
+    } else {
+        // Split the full node in halves and insert into the one idx falls into. The element
+        // is built first: args may refer to an element that the split moves away.
+        T tmp(std::forward<Args>(args)...);
+        node = as_node(pos);
+        Node* right = new_node_before(pos->next);
+        try {
+            move_tail(node, K / 2, right);
+        } catch(...) {
+            free_node(right);
+            throw;
+        }
+        if (idx > K / 2) {
+            node = right;
+            idx -= K / 2;
+        }
+        emplace_in(node, idx, std::move(tmp));
+        ++sz;
+        return {node, idx};
+    }
+    try {
+        emplace_in(node, idx, std::forward<Args>(args)...);
+    } catch(...) {
+        if (fresh) {
+            free_node(node);
+        }
+        throw;
+    }
+    ++sz;
+    return {node, idx};
+}
+
+// Returns the position of the element that followed the erased one.
+template <typename T, size_t K, typename Allocator>
+std::pair<typename UnrolledList<T, K, Allocator>::BaseNode*, size_t>
+UnrolledList<T, K, Allocator>::erase_at(Node* node, size_t idx) {
+    erase_in(node, idx);
+    --sz;
+    if (node->count == 0) {
+        BaseNode* next = node->next;
+        free_node(node);
+        return {next, 0};
+    }
+    if (node->count < min_fill) {
+        if (node->next != &fakeNode) {
+            Node* next = as_node(node->next);
+            if (node->count + next->count <= K) {
+                move_tail(next, 0, node);
+                free_node(next);
+            } else {
+                AllocTraits::construct(alloc, node->data() + node->count, std::move(next->data()[0]));
+                ++node->count;
+                erase_in(next, 0);
+            }
+        } else if (node->prev != &fakeNode) {
+            Node* prev = as_node(node->prev);
+            if (prev->count + node->count <= K) {
+                idx += prev->count;
+                move_tail(node, 0, prev);
+                free_node(node);
+                node = prev;
+            } else {
+                T* d = node->data();
+                AllocTraits::construct(alloc, d + node->count, std::move(d[node->count - 1]));
+                std::move_backward(d, d + node->count - 1, d + node->count);
+                ++node->count;
+                d[0] = std::move(prev->data()[prev->count - 1]);
+                AllocTraits::destroy(alloc, prev->data() + --prev->count);
+                ++idx;
+            }
+        }
+    }
+    if (idx == node->count) {
+        return {node->next, 0};
+    }
+    return {node, idx};
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+
+// Results are added here so that the compiler can't drop the measured work.
+inline volatile size_t bench_sink = 0;
+
+// Runs f once to warm up, then reps more times, and returns the best time in milliseconds.
+template <typename F>
+double bench_ms(F f, int reps = 5) {
+    f();
+    double best = 1e300;
+    for (int i = 0; i < reps; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double, std::milli> t = std::chrono::steady_clock::now() - start;
+        if (t.count() < best) {
+            best = t.count();
+        }
+    }
+    return best;
+}